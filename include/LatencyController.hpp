@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "PlateLocator.hpp"
+#include "Recognizer.hpp"
+
+// 一组预先验证过的定位参数：分辨率与形态学核尺寸。
+// 候选数量由 Recognizer 的 maxPlates 决定，不随档位变化
+struct LocatorProfile {
+    std::string name;
+    PlateLocator locator;
+};
+
+// 按帧耗时预算在多组定位参数间升降档：持续超出预算时降到更轻量的配置，
+// 持续明显低于预算时恢复到更精确的配置。每个视频流使用独立实例，非线程安全。
+class LatencyController {
+public:
+    explicit LatencyController(double targetMs,
+                               std::vector<LocatorProfile> profiles = defaultProfiles(1, 0),
+                               double smoothing = 0.2,
+                               int downPatience = 3,
+                               int upPatience = 30,
+                               double upRatio = 0.6);
+
+    // 由精确到轻量排列的默认配置，核尺寸随分辨率等比缩放；
+    // parallelBands 与 plateColors 分别为各配置的分块并行条带数与颜色先验，plateColors 非 0 时条带数不生效
+    static std::vector<LocatorProfile> defaultProfiles(int parallelBands = 1, unsigned plateColors = 0);
+
+    const LocatorProfile& current() const { return profiles[level]; }
+    size_t getLevel() const { return level; }
+    double getSmoothedMs() const { return smoothedMs; }
+
+    // 上报一帧的实测耗时，必要时切换配置并返回 true
+    bool update(const StageTimes& times);
+
+private:
+    void switchTo(size_t newLevel, const StageTimes& times);
+
+    double targetMs, smoothing, upRatio;
+    int downPatience, upPatience;
+    std::vector<LocatorProfile> profiles;
+
+    size_t level;
+    double smoothedMs;
+    bool hasSample;
+    int overCount, underCount;
+};
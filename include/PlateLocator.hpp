@@ -2,10 +2,22 @@
 #define PLATE_LOCATOR_H
 
 #include <opencv2/opencv.hpp>
+#include <string>
 #include <vector>
 
 class PlateLocator {
 public:
+    // 车牌底色，可按位组合
+    enum PlateColor : unsigned {
+        Blue = 1u << 0,
+        Yellow = 1u << 1,
+        Green = 1u << 2,
+        White = 1u << 3,
+    };
+
+    // 解析逗号分隔的颜色名称列表，如 "blue,yellow,green"
+    static unsigned parsePlateColors(const std::string& names);
+
     PlateLocator(
         int targetMaxWidth = 1024,
         int targetMaxHeight = 720,
@@ -15,15 +27,45 @@ public:
         int cannyThreshold1 = 100,
         int cannyThreshold2 = 200,
         cv::Size morphKernel1Size = cv::Size(44, 14),
-        cv::Size morphKernel2Size = cv::Size(9, 4)
+        cv::Size morphKernel2Size = cv::Size(9, 4),
+        bool secondMorphPass = true
     );
 
+    // preprocess 的中间结果，可在多次调用间复用以避免重复分配
+    struct Buffers {
+        cv::Mat gray, blur, norm, gamma, stretch, open, diff, binary, edge, morph1, morph2;
+        cv::Mat small, hsv, colorMask, colorRange;
+        cv::Mat result;                     // 分块模式下单个区域的输出
+        std::vector<Buffers> bandBuffers;   // 分块模式下各区域的缓冲区
+    };
+
+    // 将缩放后的图像切分为 bands 个水平条带并行预处理，bands <= 1 时整图处理；颜色先验开启时不使用条带；
+    // 条带核心高度不小于 2 * haloSize().height，实际条带数可能少于 bands
+    void setParallelBands(int bands) { numBands = bands; }
+    int getParallelBands() const { return numBands; }
+
+    // 颜色先验：只在指定底色区域（降采样 HSV 掩码膨胀后的外接矩形）内执行预处理链，
+    // 区域外的输出全部置零，locatePlates 只会在这些区域内产生候选。区域连同重叠区的总面积超过整图时
+    // 退化为整图处理后屏蔽区域之外。colors 为 0 时关闭
+    void setColorGate(unsigned colors) { colorGate = colors; }
+    unsigned getColorGate() const { return colorGate; }
+
+    // 预处理各步骤在竖直/水平方向上的最大影响范围，分块时作为条带的重叠边距
+    cv::Size haloSize() const;
+
     void preprocess(
         const cv::Mat& origin, 
         cv::Mat& resized, 
         cv::Mat& preprocessed
     ) const;
 
+    void preprocess(
+        const cv::Mat& origin,
+        cv::Mat& resized,
+        cv::Mat& preprocessed,
+        Buffers& buffers
+    ) const;
+
     std::vector<cv::Rect> locatePlates(
         const cv::Mat& preprocessedImg,
         float minAspectRatio = 2.1f,
@@ -40,12 +82,22 @@ public:
     ) const;
 
 private:
+    void stretchTopHat(const cv::Mat& resized, Buffers& buf) const;
+    void edgeMorphology(const cv::Mat& binary, cv::Mat& out, Buffers& buf) const;
+    std::vector<cv::Rect> colorRegions(const cv::Mat& resized, cv::Size halo, Buffers& buf) const;
+    void preprocessRegions(const cv::Mat& resized, const std::vector<cv::Rect>& cores, cv::Size halo,
+                           cv::Mat& preprocessed, Buffers& buf) const;
+
     int maxWidth, maxHeight;
     cv::Size blurKernel;
     double gamma;
     int radius;
     int canny1, canny2;
     cv::Size kernel1Size, kernel2Size;
+    bool secondPass;
+    int numBands = 1;
+    unsigned colorGate = 0;
+    cv::Mat topHatKernel, kernel1, kernel2;
 };
 
 #endif // PLATE_LOCATOR_H
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "PlateLocator.hpp"
+#include "model.hpp"
+
+struct PlateResult {
+    cv::Rect rect;              // 车牌在输入图像中的位置
+    std::string text;           // 识别出的车牌号
+    std::vector<int> charIds;   // 逐字符分类结果
+};
+
+// 单帧各阶段耗时（毫秒）
+struct StageTimes {
+    double preprocessMs = 0.0;
+    double locateMs = 0.0;
+    double recognizeMs = 0.0;
+    double totalMs() const { return preprocessMs + locateMs + recognizeMs; }
+};
+
+// 车牌识别器：持有已加载的模型与可复用的中间缓冲区。
+// load 完成后 recognize 可被多个线程并发调用，每次调用从缓冲池借用一份独立的工作区。
+class Recognizer {
+public:
+    explicit Recognizer(int imageSize = 20,
+                        const PlateLocator& locator = PlateLocator(),
+                        int maxPlates = 1);
+    ~Recognizer();
+
+    Recognizer(const Recognizer&) = delete;
+    Recognizer& operator=(const Recognizer&) = delete;
+
+    // classifierType 为空时根据模型目录内容自动选择分类器（见 loadClassifier）
+    bool load(const std::string& modelDir, const std::string& classifierType = "");
+    bool isLoaded() const { return classifier != nullptr; }
+
+    std::vector<PlateResult> recognize(const cv::Mat& image) const;
+
+    // 使用指定的定位器参数识别，最多识别 maxCandidates 个候选区域，times 非空时记录各阶段耗时
+    std::vector<PlateResult> recognize(const cv::Mat& image,
+                                       const PlateLocator& plateLocator,
+                                       int maxCandidates,
+                                       StageTimes* times = nullptr) const;
+
+    const CharClassifier& getClassifier() const { return *classifier; }
+    const PlateLocator& getLocator() const { return locator; }
+    int getImageSize() const { return imageSize; }
+    int getMaxPlates() const { return maxPlates; }
+
+private:
+    struct Workspace {
+        PlateLocator::Buffers buffers;
+        cv::Mat resized, preprocessed;
+    };
+
+    std::unique_ptr<Workspace> acquireWorkspace() const;
+    void releaseWorkspace(std::unique_ptr<Workspace> workspace) const;
+
+    int imageSize, maxPlates;
+    PlateLocator locator;
+    std::unique_ptr<CharClassifier> classifier;
+
+    mutable std::mutex poolMutex;
+    mutable std::vector<std::unique_ptr<Workspace>> pool;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include "model.hpp"
+
+struct EvalResult {
+    size_t count = 0;
+    double accuracy = 0.0;      // 0~1
+    double usPerChar = 0.0;     // 单字符平均预测耗时（微秒）
+};
+
+// 在 loadDataset 格式的样本（每行一个展平的字符图像）上评估分类器的准确率与预测耗时
+EvalResult evaluateClassifier(const CharClassifier& classifier, const cv::Mat& samples, const cv::Mat& labels);
+
+// 将数据集按 testRatio 划分后分别训练 PCA+SVM 与位压缩模板分类器，并排输出准确率与吞吐量
+void compareClassifiers(const std::string& dataDir, int maxPerClass = 250, double testRatio = 0.2);
+
+// 对目录下每张图像分别以整图与 bands 个条带执行 PlateLocator::preprocess，逐像素比较二者的输出，
+// 全部一致时返回 true
+bool verifyParallelBands(const std::string& imageDir, int bands);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "Recognizer.hpp"
+
+// 只读内存映射文件，用于遍历超大清单而不将其读入内存
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return opened; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool opened = false;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+};
+
+struct JobOptions {
+    std::string manifestPath;   // 每行一个图像路径
+    std::string jobDir;         // 分片输出与检查点所在目录
+    int shardIndex = 0;
+    int shardCount = 1;
+    int checkpointEvery = 1000; // 每处理多少张图像写一次检查点
+    size_t cacheEntries = 100000;   // 内容哈希缓存最多保留的条目数（LRU）
+};
+
+// 处理清单中路径哈希 % shardCount == shardIndex 的图像，结果追加写入 jobDir/shard-<i>-of-<n>.jsonl。
+// 检查点记录清单的长度、修改时间与偏移以及输出文件长度，清单与检查点不一致时拒绝续跑；输出与检查点均先刷盘再确认，重启后截去检查点之后未确认的输出并从断点继续；
+// 分片内内容哈希相同的图像只识别一次。不同路径、相同内容的图像可能落在不同分片，各分片会分别识别一次。
+bool runRecognitionJob(const JobOptions& options, const Recognizer& recognizer);
+
+// 按清单行号归并 jobDir 下所有分片输出；分片不齐全、分片数不一致或未完成时返回 false
+bool mergeJobOutputs(const std::string& jobDir, const std::string& outputPath);
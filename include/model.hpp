@@ -1,24 +1,26 @@
 #pragma once
 
 #include <opencv2/opencv.hpp>
+#include <opencv2/ml.hpp>
+#include <map>
+#include <memory>
 #include <string>
 
-class PcaSvmClassifier {
+// 字符分类器接口：输入为 charImgProcess 得到的二值字符图像，输出标签编号。
+// 标签映射（目录名 <-> 编号）由基类统一维护，与模型文件一同保存在模型目录中。
+// predict 为 const 且不修改内部状态，加载完成后可被多个线程并发调用。
+class CharClassifier {
 public:
-    PcaSvmClassifier(int numComponents = 100,
-                     double svmC = 5.0,
-                     double svmGamma = 0.1,
-                     int epochs = 100000);
+    virtual ~CharClassifier() = default;
 
-    bool train(const cv::Mat& samples, const cv::Mat& labels);
-    int predict(const cv::Mat& binaryCharImage) const;
+    virtual std::string name() const = 0;
+    virtual bool train(const cv::Mat& samples, const cv::Mat& labels) = 0;
+    // 在已训练/已加载的模型上吸收新样本，无需原始训练集
+    virtual bool update(const cv::Mat& samples, const cv::Mat& labels) = 0;
+    virtual int predict(const cv::Mat& binaryCharImage) const = 0;
 
-    bool save(const std::string& dirPath) const;
-    bool load(const std::string& dirPath);
-
-    void setNormalizationRange(double minV, double maxV);
-    double getMinVal() const { return minVal; }
-    double getMaxVal() const { return maxVal; }
+    virtual bool save(const std::string& dirPath) const = 0;
+    virtual bool load(const std::string& dirPath) = 0;
 
     void buildLabelMapFromDir(const std::string& dataDir);
     bool saveLabelMap(const std::string& filePath) const;
@@ -29,14 +31,48 @@ public:
     int labelToId(const std::string& label) const;
     std::string idToLabel(int id) const;
 
+protected:
+    std::map<std::string, int> labelMap;
+    std::map<int, std::string> inverseMap;
+};
+
+class PcaSvmClassifier : public CharClassifier {
+public:
+    PcaSvmClassifier(int numComponents = 100,
+                     double svmC = 5.0,
+                     double svmGamma = 0.1,
+                     int epochs = 100000);
+
+    std::string name() const override { return "pca_svm"; }
+    bool train(const cv::Mat& samples, const cv::Mat& labels) override;
+    // 增量更新：按样本数加权合并新旧协方差以更新 PCA，再以旧支持向量（回投到像素空间）
+    // 与新样本一起重训 SVM。旧模型缺少样本数或特征值时保持 PCA 基不变。
+    bool update(const cv::Mat& samples, const cv::Mat& labels) override;
+    int predict(const cv::Mat& binaryCharImage) const override;
+
+    bool save(const std::string& dirPath) const override;
+    bool load(const std::string& dirPath) override;
+
+    void setNormalizationRange(double minV, double maxV);
+    double getMinVal() const { return minVal; }
+    double getMaxVal() const { return maxVal; }
+
 private:
+    cv::Ptr<cv::ml::SVM> createSvm() const;
+    bool updatePca(const cv::Mat& samplesNorm);
+
     int numComponents, epochs;
     double svmC, svmGamma;
     double minVal, maxVal;
+    int numSamples;     // PCA 所基于的累计样本数
 
     cv::PCA pca;
     cv::Ptr<cv::ml::SVM> svm;
-
-    std::map<std::string, int> labelMap;
-    std::map<int, std::string> inverseMap;
 };
+
+// 按名称创建分类器（"pca_svm" 或 "bit_template"），名称未知时返回空指针
+std::unique_ptr<CharClassifier> createClassifier(const std::string& type);
+
+// 从模型目录加载分类器，type 为空时根据目录中的模型文件自动判断，
+// 同时存在多种模型时优先 pca_svm
+std::unique_ptr<CharClassifier> loadClassifier(const std::string& dirPath, const std::string& type = "");
@@ -1,8 +1,17 @@
 #pragma once
 
 #include <string>
-#include "model.hpp"
+#include "Recognizer.hpp"
 
-void recognizeImage(const std::string& imagePath, int imageSize, PcaSvmClassifier& classifier);
-void recognizeVideo(const std::string& videoPath, int imageSize, PcaSvmClassifier& classifier);
-void recognizeCamera(int cameraId, int imageSize, PcaSvmClassifier& classifier);
+void recognizeImage(const std::string& imagePath, const Recognizer& recognizer);
+// latencyBudgetMs > 0 时启用自适应延迟控制，按单帧耗时预算切换定位参数
+void recognizeVideo(const std::string& videoPath, const Recognizer& recognizer, double latencyBudgetMs = 0);
+void recognizeCamera(int cameraId, const Recognizer& recognizer, double latencyBudgetMs = 0);
+
+// 离线视频识别：按帧号将视频切分为 numWorkers 段并行识别（numWorkers <= 0 时取 CPU 核数），
+// 结果按帧顺序写入 JSONL；outVideoPath 非空时同时输出标注视频。各线程共享同一个 recognizer。
+void recognizeVideoOffline(const std::string& videoPath, const Recognizer& recognizer,
+                           const std::string& jsonlPath, const std::string& outVideoPath, int numWorkers);
+
+// 转义 JSON 字符串中的引号、反斜杠与控制字符
+std::string jsonEscape(const std::string& s);
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "model.hpp"
+
+// 位压缩模板分类器：每个训练字符按像素二值化后压缩为 numBits 位（20x20 即 400 位，7 个 64 位字），
+// 预测时用硬件 popcount 计算汉明距离并做 k 近邻投票，只涉及整数运算。
+class BitTemplateClassifier : public CharClassifier {
+public:
+    explicit BitTemplateClassifier(int k = 3);
+
+    std::string name() const override { return "bit_template"; }
+    bool train(const cv::Mat& samples, const cv::Mat& labels) override;
+    // 追加新样本的编码并去重，沿用已加载模型的 k
+    bool update(const cv::Mat& samples, const cv::Mat& labels) override;
+    int predict(const cv::Mat& binaryCharImage) const override;
+
+    bool save(const std::string& dirPath) const override;
+    bool load(const std::string& dirPath) override;
+
+    // 删除编码与标签都相同的重复模板，返回删除数量
+    size_t deduplicate();
+    // Hart 压缩近邻：只保留 1-NN 分类所必需的类原型，并将 k 置为 1，返回删除数量
+    size_t condense();
+
+    int getK() const { return k; }
+    size_t size() const { return labels.size(); }
+    size_t memoryBytes() const { return codes.size() * sizeof(uint64_t) + labels.size() * sizeof(int); }
+
+private:
+    void packRow(const cv::Mat& row, uint64_t* dst) const;
+    int hamming(const uint64_t* a, const uint64_t* b) const;
+    int nearestLabel(const uint64_t* query, const std::vector<size_t>& subset) const;
+
+    int k, numBits, numWords;
+    std::vector<uint64_t> codes;    // size() * numWords 个字，逐行连续存放
+    std::vector<int> labels;
+};
@@ -0,0 +1,70 @@
+#include "LatencyController.hpp"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+LatencyController::LatencyController(double targetMs_, std::vector<LocatorProfile> profiles_,
+                                     double smoothing_, int downPatience_, int upPatience_, double upRatio_)
+    : targetMs(targetMs_), smoothing(smoothing_), upRatio(upRatio_),
+      downPatience(downPatience_), upPatience(upPatience_), profiles(std::move(profiles_)),
+      level(0), smoothedMs(0.0), hasSample(false), overCount(0), underCount(0) {
+    if (profiles.empty()) profiles.push_back({ "default", PlateLocator() });
+}
+
+std::vector<LocatorProfile> LatencyController::defaultProfiles(int parallelBands, unsigned plateColors) {
+    std::vector<LocatorProfile> profiles = {
+        { "full",        PlateLocator() },
+        { "single-pass", PlateLocator(1024, 720, cv::Size(5, 5), 0.2, 15, 100, 200,
+                                      cv::Size(44, 14), cv::Size(9, 4), false) },
+        { "reduced",     PlateLocator(800, 560, cv::Size(5, 5), 0.2, 12, 100, 200,
+                                      cv::Size(34, 11), cv::Size(7, 3), false) },
+        { "minimal",     PlateLocator(640, 450, cv::Size(3, 3), 0.2, 9, 100, 200,
+                                      cv::Size(28, 9), cv::Size(6, 3), false) },
+    };
+    for (auto& profile : profiles) {
+        profile.locator.setParallelBands(parallelBands);
+        profile.locator.setColorGate(plateColors);
+    }
+    return profiles;
+}
+
+bool LatencyController::update(const StageTimes& times) {
+    double ms = times.totalMs();
+    smoothedMs = hasSample ? smoothing * ms + (1.0 - smoothing) * smoothedMs : ms;
+    hasSample = true;
+
+    if (smoothedMs > targetMs) {
+        ++overCount;
+        underCount = 0;
+    } else if (smoothedMs < targetMs * upRatio) {
+        ++underCount;
+        overCount = 0;
+    } else {
+        overCount = underCount = 0;
+    }
+
+    if (overCount >= downPatience && level + 1 < profiles.size()) {
+        switchTo(level + 1, times);
+        return true;
+    }
+    if (underCount >= upPatience && level > 0) {
+        switchTo(level - 1, times);
+        return true;
+    }
+    return false;
+}
+
+void LatencyController::switchTo(size_t newLevel, const StageTimes& times) {
+    std::ostringstream oss;
+    oss << std::fixed << std::setprecision(1)
+        << "[延迟控制] " << profiles[level].name << " -> " << profiles[newLevel].name
+        << "，平滑耗时 " << smoothedMs << " ms / 预算 " << targetMs << " ms"
+        << "（预处理 " << times.preprocessMs << "，定位 " << times.locateMs
+        << "，识别 " << times.recognizeMs << "）";
+    std::cout << oss.str() << std::endl;
+
+    level = newLevel;
+    // 切换后旧配置的耗时不再具有参考意义，重新累计
+    hasSample = false;
+    overCount = underCount = 0;
+}
@@ -1,5 +1,8 @@
 #include "PlateLocator.hpp"
 #include "image_utils.hpp"
+#include <cfloat>
+#include <iostream>
+#include <sstream>
 
 PlateLocator::PlateLocator(
     int targetMaxWidth, 
@@ -10,7 +13,8 @@ PlateLocator::PlateLocator(
     int cannyThreshold1, 
     int cannyThreshold2,
     cv::Size morphKernel1Size, 
-    cv::Size morphKernel2Size
+    cv::Size morphKernel2Size,
+    bool secondMorphPass
 ) : maxWidth(targetMaxWidth), 
     maxHeight(targetMaxHeight),
     blurKernel(blurKernelSize), 
@@ -19,39 +23,248 @@ PlateLocator::PlateLocator(
     canny1(cannyThreshold1), 
     canny2(cannyThreshold2),
     kernel1Size(morphKernel1Size), 
-    kernel2Size(morphKernel2Size) {}
+    kernel2Size(morphKernel2Size),
+    secondPass(secondMorphPass) {
+    topHatKernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(static_cast<int>(3.14 * radius), radius));
+    kernel1 = cv::getStructuringElement(cv::MORPH_RECT, kernel1Size);
+    kernel2 = cv::getStructuringElement(cv::MORPH_RECT, kernel2Size);
+}
+
+// 核心区域四周外扩 halo 并裁剪到图像范围内
+static cv::Rect padRegion(const cv::Rect& core, cv::Size halo, cv::Size size) {
+    return cv::Rect(core.x - halo.width, core.y - halo.height,
+                    core.width + 2 * halo.width, core.height + 2 * halo.height) & cv::Rect(0, 0, size.width, size.height);
+}
 
 void PlateLocator::preprocess(const cv::Mat& origin, cv::Mat& resized, cv::Mat& preprocessed) const {
-    cv::Mat resizedImg, grayImg, blurImg, stretchGrayImg, openImg, diffImg, binaryImg, edgeImg;
-    cv::Mat closeImg1, closeImg2, openImg1, openImg2;
+    Buffers buffers;
+    preprocess(origin, resized, preprocessed, buffers);
+}
 
+void PlateLocator::preprocess(const cv::Mat& origin, cv::Mat& resized, cv::Mat& preprocessed, Buffers& buf) const {
     double scale = std::min(static_cast<double>(maxWidth) / origin.cols, static_cast<double>(maxHeight) / origin.rows);
-    cv::resize(origin, resizedImg, cv::Size(), scale, scale, cv::INTER_LINEAR);
-    resized = resizedImg.clone();
+    cv::resize(origin, resized, cv::Size(), scale, scale, cv::INTER_LINEAR);
+
+    if (colorGate != 0) {
+        // 颜色区域内的结果不要求与整图逐像素一致，重叠区只需覆盖闭运算核，不必使用整条链的 haloSize
+        cv::Size halo = kernel1Size;
+        std::vector<cv::Rect> cores = colorRegions(resized, halo, buf);
+        double spanArea = 0;
+        for (const auto& core : cores) spanArea += padRegion(core, halo, resized.size()).area();
+        if (spanArea < static_cast<double>(resized.total())) {
+            preprocessRegions(resized, cores, halo, preprocessed, buf);
+            return;
+        }
+
+        // 颜色区域连同重叠区比整图还大时分区只会增加开销，退化为整图处理后再屏蔽区域之外
+        stretchTopHat(resized, buf);
+        cv::threshold(buf.diff, buf.binary, 0, 255, cv::THRESH_BINARY + cv::THRESH_OTSU);
+        edgeMorphology(buf.binary, buf.result, buf);
+        preprocessed.create(resized.size(), CV_8UC1);
+        preprocessed.setTo(cv::Scalar(0));
+        for (const auto& core : cores) buf.result(core).copyTo(preprocessed(core));
+        return;
+    }
+    if (numBands > 1) {
+        // 每个条带的核心高度至少为重叠边距的两倍，否则重复计算的重叠区会超过核心本身
+        int n = std::max(1, std::min(numBands, resized.rows / (2 * haloSize().height)));
+        std::vector<cv::Rect> bands;
+        for (int i = 0; i < n; ++i) {
+            int top = resized.rows * i / n, bottom = resized.rows * (i + 1) / n;
+            bands.push_back(cv::Rect(0, top, resized.cols, bottom - top));
+        }
+        preprocessRegions(resized, bands, haloSize(), preprocessed, buf);
+        return;
+    }
+
+    stretchTopHat(resized, buf);
+    cv::threshold(buf.diff, buf.binary, 0, 255, cv::THRESH_BINARY + cv::THRESH_OTSU);
+    edgeMorphology(buf.binary, preprocessed, buf);
+}
 
-    cv::cvtColor(resizedImg, grayImg, cv::COLOR_BGR2GRAY);
-    cv::GaussianBlur(grayImg, blurImg, blurKernel, 0);
+// 灰度化、伽马拉伸与顶帽变换，结果位于 buf.diff
+void PlateLocator::stretchTopHat(const cv::Mat& resized, Buffers& buf) const {
+    cv::cvtColor(resized, buf.gray, cv::COLOR_BGR2GRAY);
+    cv::GaussianBlur(buf.gray, buf.blur, blurKernel, 0);
 
-    cv::Mat normImg, gammaImg;
-    blurImg.convertTo(normImg, CV_32F, 1.0 / 255.0);
-    cv::pow(normImg, gamma, gammaImg);
-    gammaImg.convertTo(stretchGrayImg, CV_8U, 255.0);
+    buf.blur.convertTo(buf.norm, CV_32F, 1.0 / 255.0);
+    cv::pow(buf.norm, gamma, buf.gamma);
+    buf.gamma.convertTo(buf.stretch, CV_8U, 255.0);
 
-    cv::Mat rectKernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(static_cast<int>(3.14 * radius), radius));
-    cv::morphologyEx(stretchGrayImg, openImg, cv::MORPH_OPEN, rectKernel);
-    cv::absdiff(stretchGrayImg, openImg, diffImg);
+    cv::morphologyEx(buf.stretch, buf.open, cv::MORPH_OPEN, topHatKernel);
+    cv::absdiff(buf.stretch, buf.open, buf.diff);
+}
+
+// Canny 边缘检测与闭/开运算
+void PlateLocator::edgeMorphology(const cv::Mat& binary, cv::Mat& out, Buffers& buf) const {
+    cv::Canny(binary, buf.edge, canny1, canny2);
+
+    cv::morphologyEx(buf.edge, buf.morph1, cv::MORPH_CLOSE, kernel1);
+    if (!secondPass) {
+        cv::morphologyEx(buf.morph1, out, cv::MORPH_OPEN, kernel2);
+        return;
+    }
+    cv::morphologyEx(buf.morph1, buf.morph2, cv::MORPH_OPEN, kernel2);
+    cv::morphologyEx(buf.morph2, buf.morph1, cv::MORPH_CLOSE, kernel1);
+    cv::morphologyEx(buf.morph1, out, cv::MORPH_OPEN, kernel2);
+}
+
+cv::Size PlateLocator::haloSize() const {
+    // 高斯模糊半径 + 顶帽开运算 + Canny 3x3 梯度与非极大值抑制 + 每轮闭/开运算
+    // 二值图上的梯度幅值均高于 canny2，滞后阈值不会跨越更远的距离
+    int passes = secondPass ? 2 : 1;
+    int w = blurKernel.width / 2 + topHatKernel.cols + 2 + passes * (kernel1Size.width + kernel2Size.width);
+    int h = blurKernel.height / 2 + topHatKernel.rows + 2 + passes * (kernel1Size.height + kernel2Size.height);
+    return cv::Size(w + 4, h + 4);
+}
 
-    cv::threshold(diffImg, binaryImg, 0, 255, cv::THRESH_BINARY + cv::THRESH_OTSU);
-    cv::Canny(binaryImg, edgeImg, canny1, canny2);
+// 与 OpenCV THRESH_OTSU 相同的类间方差最大化，输入为 256 级直方图
+static double otsuThreshold(const std::vector<int>& hist) {
+    double total = 0, mu = 0;
+    for (int i = 0; i < 256; ++i) {
+        total += hist[i];
+        mu += i * static_cast<double>(hist[i]);
+    }
+    if (total <= 0) return 0;
+    double scale = 1.0 / total;
+    mu *= scale;
 
-    cv::Mat kernel1 = cv::getStructuringElement(cv::MORPH_RECT, kernel1Size);
-    cv::Mat kernel2 = cv::getStructuringElement(cv::MORPH_RECT, kernel2Size);
-    cv::morphologyEx(edgeImg, closeImg1, cv::MORPH_CLOSE, kernel1);
-    cv::morphologyEx(closeImg1, openImg1, cv::MORPH_OPEN, kernel2);
-    cv::morphologyEx(openImg1, closeImg2, cv::MORPH_CLOSE, kernel1);
-    cv::morphologyEx(closeImg2, openImg2, cv::MORPH_OPEN, kernel2);
+    double mu1 = 0, q1 = 0, maxSigma = 0, maxVal = 0;
+    for (int i = 0; i < 256; ++i) {
+        double p = hist[i] * scale;
+        mu1 *= q1;
+        q1 += p;
+        double q2 = 1.0 - q1;
+        if (std::min(q1, q2) < FLT_EPSILON || std::max(q1, q2) > 1.0 - FLT_EPSILON) continue;
+        mu1 = (mu1 + i * p) / q1;
+        double mu2 = (mu - q1 * mu1) / q2;
+        double sigma = q1 * q2 * (mu1 - mu2) * (mu1 - mu2);
+        if (sigma > maxSigma) {
+            maxSigma = sigma;
+            maxVal = i;
+        }
+    }
+    return maxVal;
+}
 
-    preprocessed = openImg2.clone();
+unsigned PlateLocator::parsePlateColors(const std::string& names) {
+    unsigned colors = 0;
+    std::stringstream ss(names);
+    std::string name;
+    while (std::getline(ss, name, ',')) {
+        if (name == "blue") colors |= Blue;
+        else if (name == "yellow") colors |= Yellow;
+        else if (name == "green") colors |= Green;
+        else if (name == "white") {
+            colors |= White;
+            std::cerr << "注意: 天空、墙面与路面标线同样会落入白色范围，开启白色后颜色先验几乎不再缩小处理面积" << std::endl;
+        }
+        else if (!name.empty()) std::cerr << "未知的车牌颜色: " << name << std::endl;
+    }
+    return colors;
+}
+
+// 在 1/4 分辨率的 HSV 图像上提取车牌底色掩码，膨胀后取各连通区域的外接矩形，
+// 换算回 resized 坐标并外扩半个闭运算核；外扩 halo 后相互重叠的区域合并为一个，
+// 避免同一片像素在多个区域的重叠区里被重复处理
+std::vector<cv::Rect> PlateLocator::colorRegions(const cv::Mat& resized, cv::Size halo, Buffers& buf) const {
+    const double factor = 4.0;
+    cv::resize(resized, buf.small, cv::Size(), 1.0 / factor, 1.0 / factor, cv::INTER_AREA);
+    cv::cvtColor(buf.small, buf.hsv, cv::COLOR_BGR2HSV);
+
+    struct HsvRange { unsigned color; cv::Scalar lower, upper; };
+    static const HsvRange ranges[] = {
+        { Blue,   cv::Scalar(100, 80, 60),  cv::Scalar(124, 255, 255) },
+        { Yellow, cv::Scalar(11, 80, 80),   cv::Scalar(34, 255, 255) },
+        { Green,  cv::Scalar(35, 40, 80),   cv::Scalar(85, 255, 255) },
+        { White,  cv::Scalar(0, 0, 200),    cv::Scalar(180, 30, 255) },
+    };
+
+    buf.colorMask = cv::Mat::zeros(buf.hsv.size(), CV_8UC1);
+    for (const auto& range : ranges) {
+        if (!(colorGate & range.color)) continue;
+        cv::inRange(buf.hsv, range.lower, range.upper, buf.colorRange);
+        cv::bitwise_or(buf.colorMask, buf.colorRange, buf.colorMask);
+    }
+    cv::Mat dilateKernel = cv::getStructuringElement(cv::MORPH_RECT, cv::Size(5, 3));
+    cv::dilate(buf.colorMask, buf.colorMask, dilateKernel);
+
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(buf.colorMask, contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+    cv::Rect bounds(0, 0, resized.cols, resized.rows);
+    int marginX = kernel1Size.width / 2, marginY = kernel1Size.height / 2;
+    std::vector<cv::Rect> regions;
+    for (const auto& contour : contours) {
+        if (contour.size() < 3) continue;
+        cv::Rect r = cv::boundingRect(contour);
+        if (r.area() < 6) continue;
+        cv::Rect scaled(cvFloor(r.x * factor) - marginX, cvFloor(r.y * factor) - marginY,
+                        cvCeil(r.width * factor) + 2 * marginX, cvCeil(r.height * factor) + 2 * marginY);
+        scaled &= bounds;
+        if (!scaled.empty()) regions.push_back(scaled);
+    }
+
+    // 合并后核心区域也互不重叠，各区域输出才能独立回写
+    bool merged = true;
+    while (merged) {
+        merged = false;
+        for (size_t i = 0; i < regions.size() && !merged; ++i) {
+            for (size_t j = i + 1; j < regions.size(); ++j) {
+                cv::Rect spanI = padRegion(regions[i], halo, resized.size());
+                cv::Rect spanJ = padRegion(regions[j], halo, resized.size());
+                if ((spanI & spanJ).empty()) continue;
+                regions[i] |= regions[j];
+                regions.erase(regions.begin() + j);
+                merged = true;
+                break;
+            }
+        }
+    }
+    return regions;
+}
+
+// 各区域（整幅宽的水平条带或颜色区域）四周携带 halo 的重叠区独立完成整条预处理链，
+// 只回写不含重叠区的核心部分，区域之外置零。Otsu 阈值需在所有核心区域上统一计算，
+// 因此先并行完成顶帽变换并统计核心区域直方图，合并后再继续。
+void PlateLocator::preprocessRegions(const cv::Mat& resized, const std::vector<cv::Rect>& cores, cv::Size halo,
+                                     cv::Mat& preprocessed, Buffers& buf) const {
+    int n = static_cast<int>(cores.size());
+
+    std::vector<cv::Rect> spans;
+    for (const auto& core : cores) spans.push_back(padRegion(core, halo, resized.size()));
+    if (static_cast<int>(buf.bandBuffers.size()) < n) buf.bandBuffers.resize(n);
+    std::vector<std::vector<int>> regionHists(n, std::vector<int>(256, 0));
+
+    cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& r) {
+        for (int i = r.start; i < r.end; ++i) {
+            Buffers& b = buf.bandBuffers[i];
+            stretchTopHat(resized(spans[i]), b);
+            int ox = cores[i].x - spans[i].x, oy = cores[i].y - spans[i].y;
+            for (int y = 0; y < cores[i].height; ++y) {
+                const uchar* p = b.diff.ptr<uchar>(y + oy) + ox;
+                for (int x = 0; x < cores[i].width; ++x) ++regionHists[i][p[x]];
+            }
+        }
+    });
+
+    std::vector<int> hist(256, 0);
+    for (const auto& h : regionHists) {
+        for (int v = 0; v < 256; ++v) hist[v] += h[v];
+    }
+    double thresh = otsuThreshold(hist);
+
+    preprocessed.create(resized.size(), CV_8UC1);
+    preprocessed.setTo(cv::Scalar(0));
+    cv::parallel_for_(cv::Range(0, n), [&](const cv::Range& r) {
+        for (int i = r.start; i < r.end; ++i) {
+            Buffers& b = buf.bandBuffers[i];
+            cv::threshold(b.diff, b.binary, thresh, 255, cv::THRESH_BINARY);
+            edgeMorphology(b.binary, b.result, b);
+            cv::Rect local(cores[i].x - spans[i].x, cores[i].y - spans[i].y, cores[i].width, cores[i].height);
+            b.result(local).copyTo(preprocessed(cores[i]));
+        }
+    });
 }
 
 std::vector<cv::Rect> PlateLocator::locatePlates(
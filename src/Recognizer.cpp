@@ -0,0 +1,78 @@
+#include "Recognizer.hpp"
+#include "image_utils.hpp"
+#include <chrono>
+
+Recognizer::Recognizer(int imageSize_, const PlateLocator& locator_, int maxPlates_)
+    : imageSize(imageSize_), maxPlates(maxPlates_), locator(locator_) {}
+
+Recognizer::~Recognizer() = default;
+
+bool Recognizer::load(const std::string& modelDir, const std::string& classifierType) {
+    classifier = loadClassifier(modelDir, classifierType);
+    if (classifier && !classifier->loadLabelMap(modelDir + "/label_map.txt")) classifier.reset();
+    return classifier != nullptr;
+}
+
+std::unique_ptr<Recognizer::Workspace> Recognizer::acquireWorkspace() const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (pool.empty()) return std::make_unique<Workspace>();
+    std::unique_ptr<Workspace> workspace = std::move(pool.back());
+    pool.pop_back();
+    return workspace;
+}
+
+void Recognizer::releaseWorkspace(std::unique_ptr<Workspace> workspace) const {
+    std::lock_guard<std::mutex> lock(poolMutex);
+    pool.push_back(std::move(workspace));
+}
+
+std::vector<PlateResult> Recognizer::recognize(const cv::Mat& image) const {
+    return recognize(image, locator, maxPlates);
+}
+
+std::vector<PlateResult> Recognizer::recognize(const cv::Mat& image, const PlateLocator& plateLocator,
+                                               int maxCandidates, StageTimes* times) const {
+    std::vector<PlateResult> results;
+    if (!classifier || image.empty()) return results;
+
+    using Clock = std::chrono::steady_clock;
+    auto elapsedMs = [](Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    };
+
+    std::unique_ptr<Workspace> ws = acquireWorkspace();
+    auto t0 = Clock::now();
+    plateLocator.preprocess(image, ws->resized, ws->preprocessed, ws->buffers);
+    auto t1 = Clock::now();
+    std::vector<cv::Rect> plates = plateLocator.locatePlates(ws->preprocessed);
+    if (plates.size() > static_cast<size_t>(maxCandidates)) plates.resize(maxCandidates);
+    auto t2 = Clock::now();
+
+    // 定位在缩放后的图像上进行，结果换算回输入图像坐标
+    double scale = static_cast<double>(image.cols) / ws->resized.cols;
+    cv::Rect bounds(0, 0, image.cols, image.rows);
+    for (const auto& plateRect : plates) {
+        PlateResult result;
+        result.rect = cv::Rect(cvRound(plateRect.x * scale), cvRound(plateRect.y * scale),
+                               cvRound(plateRect.width * scale), cvRound(plateRect.height * scale)) & bounds;
+
+        std::vector<cv::Mat> chars = plateLocator.segmentCharacters(ws->resized(plateRect));
+        for (const auto& charImg : chars) {
+            cv::Mat processedImg = charImgProcess(charImg, imageSize);
+            int pred = classifier->predict(processedImg);
+            result.charIds.push_back(pred);
+            result.text += classifier->idToLabel(pred);
+        }
+        results.push_back(std::move(result));
+    }
+
+    auto t3 = Clock::now();
+    releaseWorkspace(std::move(ws));
+
+    if (times) {
+        times->preprocessMs = elapsedMs(t0, t1);
+        times->locateMs = elapsedMs(t1, t2);
+        times->recognizeMs = elapsedMs(t2, t3);
+    }
+    return results;
+}
@@ -0,0 +1,132 @@
+#include "eval_utils.hpp"
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include "dataset_utils.hpp"
+#include "PlateLocator.hpp"
+#include "template_model.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point t0) {
+    return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+EvalResult evaluateClassifier(const CharClassifier& classifier, const cv::Mat& samples, const cv::Mat& labels) {
+    EvalResult result;
+    if (samples.empty()) return result;
+
+    // 还原为 predict 实际接收的 8 位方形字符图像，转换不计入预测耗时
+    int side = static_cast<int>(std::lround(std::sqrt(static_cast<double>(samples.cols))));
+    std::vector<cv::Mat> images(samples.rows);
+    for (int i = 0; i < samples.rows; ++i) {
+        cv::Mat row;
+        samples.row(i).convertTo(row, CV_8U);
+        images[i] = row.reshape(1, side).clone();
+    }
+
+    cv::Mat labelsInt;
+    labels.convertTo(labelsInt, CV_32S);
+
+    size_t correct = 0;
+    auto t0 = Clock::now();
+    for (int i = 0; i < samples.rows; ++i) {
+        if (classifier.predict(images[i]) == labelsInt.at<int>(i, 0)) ++correct;
+    }
+    double seconds = secondsSince(t0);
+
+    result.count = samples.rows;
+    result.accuracy = static_cast<double>(correct) / samples.rows;
+    result.usPerChar = seconds * 1e6 / samples.rows;
+    return result;
+}
+
+static void printRow(const std::string& name, double trainSeconds, const EvalResult& r, const std::string& note) {
+    std::cout << std::left << std::setw(22) << name << std::right
+              << std::setw(10) << std::fixed << std::setprecision(2) << trainSeconds
+              << std::setw(10) << std::setprecision(2) << r.accuracy * 100.0
+              << std::setw(12) << std::setprecision(2) << r.usPerChar
+              << std::setw(14) << std::setprecision(0) << (r.usPerChar > 0 ? 1e6 / r.usPerChar : 0.0)
+              << "  " << note << std::endl;
+}
+
+void compareClassifiers(const std::string& dataDir, int maxPerClass, double testRatio) {
+    PcaSvmClassifier pcaSvm(100, 5.0, 0.1);
+    pcaSvm.buildLabelMapFromDir(dataDir);
+
+    cv::Mat samples, labels;
+    loadDataset(dataDir, pcaSvm.getLabelMap(), samples, labels, maxPerClass);
+    if (samples.rows < 2) {
+        std::cerr << "样本数量不足: " << dataDir << std::endl;
+        return;
+    }
+    shuffleSamplesAndLabels(samples, labels);
+
+    int numTest = std::max(1, static_cast<int>(samples.rows * testRatio));
+    int numTrain = samples.rows - numTest;
+    cv::Mat trainX = samples.rowRange(0, numTrain), trainY = labels.rowRange(0, numTrain);
+    cv::Mat testX = samples.rowRange(numTrain, samples.rows), testY = labels.rowRange(numTrain, samples.rows);
+    std::cout << "训练样本: " << numTrain << "，测试样本: " << numTest << std::endl;
+
+    auto t0 = Clock::now();
+    if (!pcaSvm.train(trainX, trainY)) {
+        std::cerr << "PCA+SVM 训练失败" << std::endl;
+        return;
+    }
+    double pcaSvmTrain = secondsSince(t0);
+    EvalResult pcaSvmEval = evaluateClassifier(pcaSvm, testX, testY);
+
+    BitTemplateClassifier templates;
+    t0 = Clock::now();
+    templates.train(trainX, trainY);
+    templates.deduplicate();
+    double templateTrain = secondsSince(t0);
+    EvalResult templateEval = evaluateClassifier(templates, testX, testY);
+    std::string templateNote = std::to_string(templates.size()) + " 个模板, " +
+                               std::to_string(templates.memoryBytes() / 1024) + " KB";
+
+    BitTemplateClassifier pruned;
+    t0 = Clock::now();
+    pruned.train(trainX, trainY);
+    pruned.deduplicate();
+    pruned.condense();
+    double prunedTrain = secondsSince(t0);
+    EvalResult prunedEval = evaluateClassifier(pruned, testX, testY);
+    std::string prunedNote = std::to_string(pruned.size()) + " 个模板, k=1, " +
+                             std::to_string(pruned.memoryBytes() / 1024) + " KB";
+
+    std::cout << std::left << std::setw(22) << "分类器" << std::right
+              << std::setw(10) << "训练(s)" << std::setw(10) << "准确率(%)"
+              << std::setw(12) << "单字符(us)" << std::setw(14) << "吞吐(字符/s)" << std::endl;
+    printRow("pca_svm", pcaSvmTrain, pcaSvmEval, "");
+    printRow("bit_template", templateTrain, templateEval, templateNote);
+    printRow("bit_template (pruned)", prunedTrain, prunedEval, prunedNote);
+}
+
+bool verifyParallelBands(const std::string& imageDir, int bands) {
+    PlateLocator whole, banded;
+    banded.setParallelBands(bands);
+    cv::Size halo = banded.haloSize();
+    std::cout << "条带数 " << bands << "，重叠边距 " << halo.width << "x" << halo.height << std::endl;
+
+    size_t images = 0, mismatched = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(imageDir)) {
+        if (!entry.is_regular_file()) continue;
+        cv::Mat img = cv::imread(entry.path().string());
+        if (img.empty()) continue;
+
+        cv::Mat resizedA, resizedB, maskA, maskB;
+        whole.preprocess(img, resizedA, maskA);
+        banded.preprocess(img, resizedB, maskB);
+        int diff = cv::countNonZero(maskA != maskB);
+        ++images;
+        if (diff != 0) ++mismatched;
+        std::cout << entry.path().filename().string() << ": " << maskA.cols << "x" << maskA.rows
+                  << (diff == 0 ? "，一致" : "，不一致像素 " + std::to_string(diff)) << std::endl;
+    }
+
+    std::cout << "共 " << images << " 张图像，不一致 " << mismatched << " 张" << std::endl;
+    return images > 0 && mismatched == 0;
+}
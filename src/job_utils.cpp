@@ -0,0 +1,502 @@
+#include "job_utils.hpp"
+#include "recognize_utils.hpp"
+
+#include <opencv2/opencv.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <queue>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return;
+    fileHandle = file;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) return;
+    size_ = static_cast<size_t>(fileSize.QuadPart);
+    if (size_ == 0) {
+        opened = true;
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) return;
+    mappingHandle = mapping;
+    data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    opened = data_ != nullptr;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if (::fstat(fd, &st) == 0) {
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ == 0) {
+            opened = true;
+        } else {
+            void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                ::madvise(p, size_, MADV_SEQUENTIAL);
+                data_ = static_cast<const char*>(p);
+                opened = true;
+            }
+        }
+    }
+    ::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifdef _WIN32
+    if (data_) UnmapViewOfFile(data_);
+    if (mappingHandle) CloseHandle(static_cast<HANDLE>(mappingHandle));
+    if (fileHandle) CloseHandle(static_cast<HANDLE>(fileHandle));
+#else
+    if (data_) ::munmap(const_cast<char*>(data_), size_);
+#endif
+}
+
+// FNV-1a 64 位哈希，用于内容去重与按路径分片
+static uint64_t fnv1a(const void* data, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t h = 1469598103934665603ULL;
+    for (size_t i = 0; i < size; ++i) {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static std::string contentHash(const std::vector<uchar>& bytes) {
+    char buf[17];
+    std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(fnv1a(bytes.data(), bytes.size())));
+    return buf;
+}
+
+// 将已写入的文件内容刷到磁盘。isDir 为 true 时同步目录项，使改名操作持久化（Windows 上无需也无法同步目录）
+static bool syncPath(const std::string& path, bool isDir = false) {
+#ifdef _WIN32
+    if (isDir) return true;
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    bool ok = FlushFileBuffers(file) != 0;
+    CloseHandle(file);
+    return ok;
+#else
+    int fd = ::open(path.c_str(), isDir ? O_RDONLY : O_WRONLY);
+    if (fd < 0) return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+#endif
+}
+
+// 以哈希为键、识别结果 JSON 为值的 LRU 缓存，容量固定，避免超大归档下无限增长
+class PlateCache {
+public:
+    explicit PlateCache(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {}
+
+    const std::string* find(const std::string& hash) {
+        auto it = index.find(hash);
+        if (it == index.end()) return nullptr;
+        entries.splice(entries.begin(), entries, it->second);
+        return &it->second->second;
+    }
+
+    void put(const std::string& hash, const std::string& plates) {
+        auto it = index.find(hash);
+        if (it != index.end()) {
+            it->second->second = plates;
+            entries.splice(entries.begin(), entries, it->second);
+            return;
+        }
+        entries.emplace_front(hash, plates);
+        index[hash] = entries.begin();
+        if (entries.size() > capacity) {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+
+    size_t size() const { return entries.size(); }
+
+private:
+    size_t capacity;
+    std::list<std::pair<std::string, std::string>> entries;    // 最近使用的在前
+    std::unordered_map<std::string, std::list<std::pair<std::string, std::string>>::iterator> index;
+};
+
+static std::string shardName(const JobOptions& options) {
+    return "shard-" + std::to_string(options.shardIndex) + "-of-" + std::to_string(options.shardCount);
+}
+
+struct Checkpoint {
+    uint64_t manifestSize = 0;      // 清单文件长度与修改时间，用于识别断点续跑时清单是否被替换或修改
+    uint64_t manifestMtime = 0;
+    uint64_t manifestOffset = 0;    // 下一行在清单中的字节偏移
+    uint64_t lineNumber = 0;        // 下一行的行号（从 0 开始）
+    uint64_t outputSize = 0;        // 已确认的输出文件长度
+    bool done = false;
+};
+
+static bool readCheckpoint(const std::string& path, Checkpoint& ckpt) {
+    std::ifstream ifs(path);
+    if (!ifs.is_open()) return false;
+    std::string key;
+    uint64_t value;
+    while (ifs >> key >> value) {
+        if (key == "manifest_size") ckpt.manifestSize = value;
+        else if (key == "manifest_mtime") ckpt.manifestMtime = value;
+        else if (key == "manifest_offset") ckpt.manifestOffset = value;
+        else if (key == "line") ckpt.lineNumber = value;
+        else if (key == "output_size") ckpt.outputSize = value;
+        else if (key == "done") ckpt.done = value != 0;
+    }
+    return true;
+}
+
+// 先写临时文件并刷盘再改名，保证检查点文件始终完整，且不会先于它所描述的输出落盘
+static bool writeCheckpoint(const std::string& path, const Checkpoint& ckpt) {
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream ofs(tmpPath, std::ios::trunc);
+        if (!ofs.is_open()) return false;
+        ofs << "manifest_size " << ckpt.manifestSize << "\n"
+            << "manifest_mtime " << ckpt.manifestMtime << "\n"
+            << "manifest_offset " << ckpt.manifestOffset << "\n"
+            << "line " << ckpt.lineNumber << "\n"
+            << "output_size " << ckpt.outputSize << "\n"
+            << "done " << (ckpt.done ? 1 : 0) << "\n";
+        if (!ofs.flush()) return false;
+    }
+    if (!syncPath(tmpPath)) return false;
+    std::error_code ec;
+    std::filesystem::rename(tmpPath, path, ec);
+    if (ec) return false;
+    std::string dir = std::filesystem::path(path).parent_path().string();
+    return syncPath(dir.empty() ? "." : dir, true);
+}
+
+// 从一条输出记录中取出字段的原始 JSON 文本（数字、字符串或数组）
+static std::string extractField(const std::string& record, const std::string& key) {
+    std::string pattern = "\"" + key + "\":";
+    size_t pos = record.find(pattern);
+    if (pos == std::string::npos) return "";
+    pos += pattern.size();
+    if (pos >= record.size()) return "";
+
+    size_t end = pos;
+    if (record[pos] == '"') {
+        end = pos + 1;
+        while (end < record.size() && record[end] != '"') end += record[end] == '\\' ? 2 : 1;
+        return record.substr(pos + 1, end - pos - 1);
+    }
+    if (record[pos] == '[') {
+        int depth = 0;
+        bool inString = false;
+        for (; end < record.size(); ++end) {
+            char c = record[end];
+            if (inString) {
+                if (c == '\\') ++end;
+                else if (c == '"') inString = false;
+            } else if (c == '"') {
+                inString = true;
+            } else if (c == '[') {
+                ++depth;
+            } else if (c == ']' && --depth == 0) {
+                break;
+            }
+        }
+        return record.substr(pos, end - pos + 1);
+    }
+    while (end < record.size() && record[end] != ',' && record[end] != '}') ++end;
+    return record.substr(pos, end - pos);
+}
+
+static std::string platesToJson(const std::vector<PlateResult>& plates) {
+    std::ostringstream oss;
+    oss << "[";
+    for (size_t i = 0; i < plates.size(); ++i) {
+        const auto& p = plates[i];
+        if (i) oss << ",";
+        oss << "{\"text\":\"" << jsonEscape(p.text) << "\",\"rect\":["
+            << p.rect.x << "," << p.rect.y << "," << p.rect.width << "," << p.rect.height << "]}";
+    }
+    oss << "]";
+    return oss.str();
+}
+
+static bool readFileBytes(const std::string& path, std::vector<uchar>& bytes) {
+    std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+    if (!ifs.is_open()) return false;
+    std::streamsize size = ifs.tellg();
+    if (size <= 0) return false;
+    bytes.resize(static_cast<size_t>(size));
+    ifs.seekg(0);
+    return static_cast<bool>(ifs.read(reinterpret_cast<char*>(bytes.data()), size));
+}
+
+bool runRecognitionJob(const JobOptions& options, const Recognizer& recognizer) {
+    if (options.shardCount <= 0 || options.shardIndex < 0 || options.shardIndex >= options.shardCount) {
+        std::cerr << "分片参数无效: " << options.shardIndex << "/" << options.shardCount << std::endl;
+        return false;
+    }
+
+    MappedFile manifest(options.manifestPath);
+    if (!manifest.isOpen()) {
+        std::cerr << "无法打开清单文件: " << options.manifestPath << std::endl;
+        return false;
+    }
+
+    std::filesystem::create_directories(options.jobDir);
+    std::string base = options.jobDir + "/" + shardName(options);
+    std::string outputPath = base + ".jsonl";
+    std::string checkpointPath = base + ".ckpt";
+
+    std::error_code ec;
+    uint64_t manifestMtime = static_cast<uint64_t>(
+        std::filesystem::last_write_time(options.manifestPath, ec).time_since_epoch().count());
+
+    Checkpoint ckpt;
+    bool resumed = readCheckpoint(checkpointPath, ckpt);
+    // 检查点中的偏移只对同一份清单有效，清单被替换或修改后从该偏移继续会读到任意位置（甚至行中间）
+    if (resumed && (ckpt.manifestSize != manifest.size() || ckpt.manifestMtime != manifestMtime)) {
+        std::cerr << "清单 " << options.manifestPath << " 与检查点 " << checkpointPath
+                  << " 记录的不一致（长度或修改时间不同），拒绝续跑。若确需使用新清单，请删除 " << outputPath
+                  << " 与 " << checkpointPath << " 后重新运行该分片" << std::endl;
+        return false;
+    }
+    ckpt.manifestSize = manifest.size();
+    ckpt.manifestMtime = manifestMtime;
+    if (ckpt.done) {
+        std::cout << "分片 " << shardName(options) << " 已完成，跳过" << std::endl;
+        return true;
+    }
+
+    // 截去上次检查点之后写入的未确认记录，这些行会在本次重新处理。
+    // 输出比检查点记录的还短说明已确认的结果丢失，继续运行会留下空洞，直接报错
+    uint64_t existingSize = std::filesystem::exists(outputPath, ec) ? std::filesystem::file_size(outputPath, ec) : 0;
+    if (!resumed) ckpt.outputSize = 0;
+    if (existingSize < ckpt.outputSize) {
+        std::cerr << "分片输出 " << outputPath << " 长度 " << existingSize << " 小于检查点记录的 " << ckpt.outputSize
+                  << "，已确认的结果丢失。请删除 " << outputPath << " 与 " << checkpointPath << " 后重新运行该分片"
+                  << std::endl;
+        return false;
+    }
+    if (existingSize > ckpt.outputSize) {
+        std::filesystem::resize_file(outputPath, ckpt.outputSize, ec);
+        if (ec) {
+            std::cerr << "无法将分片输出 " << outputPath << " 截断到检查点记录的长度 " << ckpt.outputSize << ": "
+                      << ec.message() << "。请删除 " << outputPath << " 与 " << checkpointPath << " 后重新运行该分片"
+                      << std::endl;
+            return false;
+        }
+    }
+    uint64_t outputBytes = ckpt.outputSize;
+
+    // 由已确认的输出重建内容哈希缓存，重复或重试的图像直接复用结果；按写入顺序插入，LRU 保留最近的记录
+    PlateCache cache(options.cacheEntries);
+    {
+        std::ifstream existing(outputPath);
+        std::string record;
+        while (std::getline(existing, record)) {
+            std::string hash = extractField(record, "hash");
+            std::string plates = extractField(record, "plates");
+            if (!hash.empty() && !plates.empty()) cache.put(hash, plates);
+        }
+    }
+
+    std::ofstream output(outputPath, std::ios::app | std::ios::binary);
+    if (!output.is_open()) {
+        std::cerr << "无法写入分片输出: " << outputPath << std::endl;
+        return false;
+    }
+
+    if (resumed) {
+        std::cout << "从检查点恢复: 第 " << ckpt.lineNumber << " 行，已缓存 " << cache.size() << " 个哈希" << std::endl;
+    }
+
+    const char* data = manifest.data();
+    size_t size = manifest.size();
+    size_t offset = std::min<size_t>(ckpt.manifestOffset, size);
+    uint64_t lineNumber = ckpt.lineNumber;
+    size_t processed = 0, recognized = 0, reused = 0, failed = 0, sinceCheckpoint = 0;
+    std::vector<uchar> bytes;
+
+    auto commit = [&](size_t nextOffset, uint64_t nextLine, bool done) {
+        output.flush();
+        if (!syncPath(outputPath)) std::cerr << "分片输出刷盘失败: " << outputPath << std::endl;
+        ckpt.manifestOffset = nextOffset;
+        ckpt.lineNumber = nextLine;
+        ckpt.outputSize = outputBytes;
+        ckpt.done = done;
+        if (!writeCheckpoint(checkpointPath, ckpt)) std::cerr << "检查点写入失败: " << checkpointPath << std::endl;
+    };
+
+    while (offset < size) {
+        const char* lineStart = data + offset;
+        const char* newline = static_cast<const char*>(std::memchr(lineStart, '\n', size - offset));
+        size_t lineLen = newline ? static_cast<size_t>(newline - lineStart) : size - offset;
+        size_t nextOffset = offset + lineLen + (newline ? 1 : 0);
+        uint64_t line = lineNumber++;
+        offset = nextOffset;
+
+        std::string path(lineStart, lineLen);
+        if (!path.empty() && path.back() == '\r') path.pop_back();
+        if (path.empty()) continue;
+        // 按路径哈希而不是行号分片，清单中重复出现的同一路径总是落在同一分片并命中其缓存
+        if (fnv1a(path.data(), path.size()) % options.shardCount != static_cast<uint64_t>(options.shardIndex)) continue;
+
+        std::ostringstream record;
+        record << "{\"line\":" << line << ",\"path\":\"" << jsonEscape(path) << "\"";
+        if (!readFileBytes(path, bytes)) {
+            record << ",\"error\":\"read\"}";
+            ++failed;
+        } else {
+            std::string hash = contentHash(bytes);
+            const std::string* cached = cache.find(hash);
+            if (cached) {
+                record << ",\"hash\":\"" << hash << "\",\"plates\":" << *cached << ",\"cached\":true}";
+                ++reused;
+            } else {
+                cv::Mat image = cv::imdecode(bytes, cv::IMREAD_COLOR);
+                if (image.empty()) {
+                    record << ",\"hash\":\"" << hash << "\",\"error\":\"decode\"}";
+                    ++failed;
+                } else {
+                    std::string plates = platesToJson(recognizer.recognize(image));
+                    cache.put(hash, plates);
+                    record << ",\"hash\":\"" << hash << "\",\"plates\":" << plates << "}";
+                    ++recognized;
+                }
+            }
+        }
+        record << "\n";
+        std::string text = record.str();
+        output << text;
+        outputBytes += text.size();
+        ++processed;
+
+        if (++sinceCheckpoint >= static_cast<size_t>(std::max(1, options.checkpointEvery))) {
+            commit(nextOffset, lineNumber, false);
+            sinceCheckpoint = 0;
+            std::cout << "[" << shardName(options) << "] 已处理 " << processed << "（识别 " << recognized
+                      << "，复用 " << reused << "，失败 " << failed << "）" << std::endl;
+        }
+    }
+
+    commit(offset, lineNumber, true);
+    std::cout << "[" << shardName(options) << "] 完成: 处理 " << processed << "，识别 " << recognized
+              << "，复用 " << reused << "，失败 " << failed << "，输出 " << outputPath << std::endl;
+    return true;
+}
+
+// 每个分片输出都按行号递增写入，多路归并即可得到整体有序的结果。
+// 合并前检查所有分片属于同一分片数、编号齐全且检查点均已标记完成，否则拒绝合并
+bool mergeJobOutputs(const std::string& jobDir, const std::string& outputPath) {
+    std::vector<std::filesystem::path> shardPaths;
+    int shardCount = -1;
+    std::vector<bool> present;
+    bool ok = true;
+    for (const auto& entry : std::filesystem::directory_iterator(jobDir)) {
+        std::string stem = entry.path().stem().string();
+        int index = -1, count = -1;
+        char tail = 0;
+        if (!entry.is_regular_file() || entry.path().extension() != ".jsonl") continue;
+        if (std::sscanf(stem.c_str(), "shard-%d-of-%d%c", &index, &count, &tail) != 2) continue;
+
+        if (shardCount < 0) {
+            shardCount = count;
+            present.assign(std::max(count, 0), false);
+        }
+        if (count != shardCount || index < 0 || index >= count) {
+            std::cerr << "分片 " << stem << " 与其他分片的分片数 " << shardCount << " 不一致" << std::endl;
+            ok = false;
+            continue;
+        }
+        Checkpoint ckpt;
+        std::filesystem::path ckptPath = entry.path();
+        ckptPath.replace_extension(".ckpt");
+        if (!readCheckpoint(ckptPath.string(), ckpt) || !ckpt.done) {
+            std::cerr << "分片 " << stem << " 尚未完成（检查点 " << ckptPath.string() << " 未标记 done 1）" << std::endl;
+            ok = false;
+        }
+        present[index] = true;
+        shardPaths.push_back(entry.path());
+    }
+    if (shardPaths.empty()) {
+        std::cerr << "未找到分片输出: " << jobDir << std::endl;
+        return false;
+    }
+    for (int i = 0; i < shardCount; ++i) {
+        if (!present[i]) {
+            std::cerr << "缺少分片 shard-" << i << "-of-" << shardCount << std::endl;
+            ok = false;
+        }
+    }
+    if (!ok) {
+        std::cerr << "分片不完整，拒绝合并" << std::endl;
+        return false;
+    }
+
+    std::vector<std::unique_ptr<std::ifstream>> inputs;
+    for (const auto& path : shardPaths) inputs.push_back(std::make_unique<std::ifstream>(path));
+
+    std::ofstream output(outputPath, std::ios::trunc | std::ios::binary);
+    if (!output.is_open()) {
+        std::cerr << "无法写入合并结果: " << outputPath << std::endl;
+        return false;
+    }
+
+    struct Head {
+        uint64_t line;
+        size_t source;
+        std::string record;
+        bool operator>(const Head& other) const { return line > other.line; }
+    };
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    auto advance = [&](size_t source) {
+        std::string record;
+        while (std::getline(*inputs[source], record)) {
+            std::string line = extractField(record, "line");
+            if (line.empty()) continue;
+            heads.push({ std::stoull(line), source, std::move(record) });
+            return;
+        }
+    };
+    for (size_t i = 0; i < inputs.size(); ++i) advance(i);
+
+    // 每行清单只属于一个分片，续跑又会截去未确认的输出，各分片之间不会出现相同行号
+    size_t written = 0;
+    while (!heads.empty()) {
+        Head head = heads.top();
+        heads.pop();
+        output << head.record << "\n";
+        ++written;
+        advance(head.source);
+    }
+
+    std::cout << "合并 " << inputs.size() << " 个分片，共 " << written << " 条记录，输出 " << outputPath << std::endl;
+    return true;
+}
@@ -1,11 +1,19 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <climits>
 #include "PlateLocator.hpp"
 #include "image_utils.hpp"
 #include "dataset_utils.hpp"
 #include "model.hpp"
+#include "template_model.hpp"
+#include "eval_utils.hpp"
+#include "Recognizer.hpp"
 #include "recognize_utils.hpp"
+#include "job_utils.hpp"
 
 std::string getCurrentTimestamp() {
     auto t = std::time(nullptr);
@@ -16,9 +24,13 @@ std::string getCurrentTimestamp() {
 }
 
 int main(int argc, char** argv) {
-    bool isRaw = false, isTrain = false, isPredict = false;
+    bool isRaw = false, isTrain = false, isPredict = false, isOffline = false, isCompare = false, prune = false;
+    bool isUpdate = false, isJob = false, isMerge = false, isVerifyBands = false;
     std::string dataDir, modelOutDir, modelLoadDir, imagePath, inputDir, outputDir, videoPath;
-    int imageSize = -1, cameraId = -1;
+    std::string outputJsonl, outputVideo, classifierType, evalDir, fullDataDir, plateColors, manifestPath, jobDir;
+    int imageSize = -1, cameraId = -1, numWorkers = 0, numBands = 1;
+    int shardIndex = 0, shardCount = 1, checkpointEvery = 1000;
+    double latencyBudgetMs = 0;
 
     for (int i = 1; i < argc; ++i) {
         std::string arg = argv[i];
@@ -33,6 +45,31 @@ int main(int argc, char** argv) {
         else if (arg == "--image-path" && i + 1 < argc) imagePath = argv[++i];
         else if (arg == "--video-path" && i + 1 < argc) videoPath = argv[++i];
         else if (arg == "--camera-id" && i + 1 < argc) cameraId = std::stoi(argv[++i]);
+        else if (arg == "--offline") isOffline = true;
+        else if (arg == "--output-jsonl" && i + 1 < argc) outputJsonl = argv[++i];
+        else if (arg == "--output-video" && i + 1 < argc) outputVideo = argv[++i];
+        else if (arg == "--workers" && i + 1 < argc) numWorkers = std::stoi(argv[++i]);
+        else if (arg == "--latency-budget" && i + 1 < argc) latencyBudgetMs = std::stod(argv[++i]);
+        else if (arg == "--bands" && i + 1 < argc) numBands = std::stoi(argv[++i]);
+        else if (arg == "--verify-bands") isVerifyBands = true;
+        else if (arg == "--plate-colors" && i + 1 < argc) plateColors = argv[++i];
+        else if (arg == "--job") isJob = true;
+        else if (arg == "--merge") isMerge = true;
+        else if (arg == "--manifest" && i + 1 < argc) manifestPath = argv[++i];
+        else if (arg == "--job-dir" && i + 1 < argc) jobDir = argv[++i];
+        else if (arg == "--shard-index" && i + 1 < argc) shardIndex = std::stoi(argv[++i]);
+        else if (arg == "--shard-count" && i + 1 < argc) shardCount = std::stoi(argv[++i]);
+        else if (arg == "--checkpoint-every" && i + 1 < argc) checkpointEvery = std::stoi(argv[++i]);
+        else if (arg == "--classifier" && i + 1 < argc) classifierType = argv[++i];
+        else if (arg == "--prune") prune = true;
+        else if (arg == "--compare") isCompare = true;
+        else if (arg == "--update") isUpdate = true;
+        else if (arg == "--eval-dir" && i + 1 < argc) evalDir = argv[++i];
+        else if (arg == "--full-data-dir" && i + 1 < argc) fullDataDir = argv[++i];
+    }
+
+    if (numBands > 1 && !plateColors.empty()) {
+        std::cerr << "注意: --plate-colors 与 --bands 不能同时生效，颜色先验开启时按颜色区域并行处理，--bands 将被忽略" << std::endl;
     }
 
     if (isRaw && !inputDir.empty() && !outputDir.empty()) {
@@ -44,27 +81,53 @@ int main(int argc, char** argv) {
         return 0;
     }
 
+    if (isVerifyBands && !inputDir.empty()) {
+        return verifyParallelBands(inputDir, numBands > 1 ? numBands : 4) ? 0 : -1;
+    }
+
+    if (isCompare && !dataDir.empty()) {
+        compareClassifiers(dataDir);
+        return 0;
+    }
+
     if (isTrain && !dataDir.empty()) {
-        std::string modelName = "pca_svm";
+        std::unique_ptr<CharClassifier> classifier;
+        if (classifierType.empty() || classifierType == "pca_svm") {
+            classifier = std::make_unique<PcaSvmClassifier>(100, 5.0, 0.1);
+        } else {
+            classifier = createClassifier(classifierType);
+        }
+        if (!classifier) {
+            std::cerr << "未知的分类器类型: " << classifierType << std::endl;
+            return -1;
+        }
+
+        std::string modelName = classifier->name();
         std::string timestamp = getCurrentTimestamp();
         modelOutDir = "models/" + modelName + "_" + timestamp;
 
         std::filesystem::create_directories(modelOutDir);
 
-        PcaSvmClassifier classifier(100, 5.0, 0.1);
-        classifier.buildLabelMapFromDir(dataDir);
-        classifier.saveLabelMap(modelOutDir);
+        classifier->buildLabelMapFromDir(dataDir);
+        classifier->saveLabelMap(modelOutDir);
 
         cv::Mat samples, labels;
-        loadDataset(dataDir, classifier.getLabelMap(), samples, labels, 250);
+        loadDataset(dataDir, classifier->getLabelMap(), samples, labels, 250);
         shuffleSamplesAndLabels(samples, labels);
 
-        if (!classifier.train(samples, labels)) {
+        if (!classifier->train(samples, labels)) {
             std::cerr << "训练失败。" << std::endl;
             return -1;
         }
 
-        if (!classifier.save(modelOutDir)) {
+        if (auto* templates = dynamic_cast<BitTemplateClassifier*>(classifier.get())) {
+            size_t duplicates = templates->deduplicate();
+            size_t pruned = prune ? templates->condense() : 0;
+            std::cout << "去重 " << duplicates << " 个，压缩 " << pruned << " 个，保留模板 "
+                      << templates->size() << " 个（" << templates->memoryBytes() / 1024 << " KB）" << std::endl;
+        }
+
+        if (!classifier->save(modelOutDir)) {
             std::cerr << "模型保存失败。" << std::endl;
             return -1;
         }
@@ -73,35 +136,166 @@ int main(int argc, char** argv) {
         return 0;
     }
 
-    if (isPredict && !modelLoadDir.empty() && imageSize != -1) {
-        PcaSvmClassifier classifier;
-        if (!classifier.load(modelLoadDir)) {
-            std::cerr << "模型加载失败" << std::endl;
+    if (isUpdate && !modelLoadDir.empty() && !dataDir.empty()) {
+        std::unique_ptr<CharClassifier> classifier = loadClassifier(modelLoadDir, classifierType);
+        if (!classifier || !classifier->loadLabelMap(modelLoadDir + "/label_map.txt")) {
+            std::cerr << "模型或标签映射加载失败: " << modelLoadDir << std::endl;
             return -1;
         }
-        if (!classifier.loadLabelMap(modelLoadDir + "/label_map.txt")) {
-            std::cerr << "标签映射加载失败" << std::endl;
+
+        cv::Mat newSamples, newLabels;
+        loadDataset(dataDir, classifier->getLabelMap(), newSamples, newLabels, INT_MAX);
+        if (newSamples.empty()) {
+            std::cerr << "未读取到新样本: " << dataDir << std::endl;
+            return -1;
+        }
+
+        // 未指定评估集时与 compareClassifiers 一样按 8:2 留出部分新样本评估，只用其余样本更新；
+        // 新样本过少无法留出时只能在训练样本上评估，输出中标注为样本内结果
+        cv::Mat evalSamples, evalLabels;
+        std::string evalNote;
+        if (!evalDir.empty()) {
+            loadDataset(evalDir, classifier->getLabelMap(), evalSamples, evalLabels, 250);
+            evalNote = evalDir;
+        } else if (newSamples.rows >= 5) {
+            shuffleSamplesAndLabels(newSamples, newLabels);
+            int numEval = std::max(1, newSamples.rows / 5);
+            int numTrain = newSamples.rows - numEval;
+            evalSamples = newSamples.rowRange(numTrain, newSamples.rows).clone();
+            evalLabels = newLabels.rowRange(numTrain, newLabels.rows).clone();
+            newSamples = newSamples.rowRange(0, numTrain).clone();
+            newLabels = newLabels.rowRange(0, numTrain).clone();
+            evalNote = "新样本留出 20%";
+        } else {
+            evalSamples = newSamples;
+            evalLabels = newLabels;
+            evalNote = "新样本（样本内，结果偏乐观）";
+        }
+
+        EvalResult before = evaluateClassifier(*classifier, evalSamples, evalLabels);
+        auto t0 = std::chrono::steady_clock::now();
+        if (!classifier->update(newSamples, newLabels)) {
+            std::cerr << "增量更新失败。" << std::endl;
+            return -1;
+        }
+        double updateSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        EvalResult after = evaluateClassifier(*classifier, evalSamples, evalLabels);
+
+        modelOutDir = "models/" + classifier->name() + "_" + getCurrentTimestamp();
+        if (!classifier->save(modelOutDir) || !classifier->saveLabelMap(modelOutDir)) {
+            std::cerr << "模型保存失败。" << std::endl;
+            return -1;
+        }
+        std::ofstream lineage(modelOutDir + "/lineage.txt");
+        lineage << "parent " << modelLoadDir << "\n"
+                << "update_data " << dataDir << "\n"
+                << "new_samples " << newSamples.rows << "\n"
+                << "eval " << evalNote << " (" << evalSamples.rows << ")\n";
+
+        std::cout << std::fixed << std::setprecision(2)
+                  << "更新样本: " << newSamples.rows << "，评估样本: " << evalSamples.rows << "（" << evalNote << "）\n"
+                  << "增量更新: 准确率 " << before.accuracy * 100.0 << "% -> " << after.accuracy * 100.0
+                  << "%，耗时 " << updateSeconds << " s" << std::endl;
+
+        if (!fullDataDir.empty()) {
+            std::unique_ptr<CharClassifier> full = createClassifier(classifier->name());
+            cv::Mat samples, labels;
+            loadDataset(fullDataDir, classifier->getLabelMap(), samples, labels, 250);
+            samples.push_back(newSamples);
+            labels.push_back(newLabels);
+            shuffleSamplesAndLabels(samples, labels);
+
+            // 与 --train 相同的训练后处理：模板分类器去重，来源模型经过压缩（k=1）时同样压缩，
+            // 保证与增量更新得到的是同一种分类器
+            t0 = std::chrono::steady_clock::now();
+            bool trained = full && full->train(samples, labels);
+            auto* fullTemplates = dynamic_cast<BitTemplateClassifier*>(full.get());
+            auto* parentTemplates = dynamic_cast<BitTemplateClassifier*>(classifier.get());
+            if (trained && fullTemplates && parentTemplates) {
+                fullTemplates->deduplicate();
+                if (parentTemplates->getK() == 1) fullTemplates->condense();
+            }
+            if (trained) {
+                double fullSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+                EvalResult fullEval = evaluateClassifier(*full, evalSamples, evalLabels);
+                std::cout << "完整重训: 准确率 " << fullEval.accuracy * 100.0 << "%，耗时 " << fullSeconds
+                          << " s（" << samples.rows << " 个样本），增量更新耗时为其 "
+                          << (fullSeconds > 0 ? updateSeconds / fullSeconds * 100.0 : 0.0) << "%" << std::endl;
+            } else {
+                std::cerr << "完整重训失败。" << std::endl;
+            }
+        }
+
+        std::cout << "更新完成，新模型已保存到：" << modelOutDir << std::endl;
+        return 0;
+    }
+
+    if (isMerge && !jobDir.empty() && !outputJsonl.empty()) {
+        return mergeJobOutputs(jobDir, outputJsonl) ? 0 : -1;
+    }
+
+    if (isJob && !modelLoadDir.empty() && imageSize != -1 && !manifestPath.empty() && !jobDir.empty()) {
+        PlateLocator locator;
+        locator.setParallelBands(numBands);
+        locator.setColorGate(PlateLocator::parsePlateColors(plateColors));
+        Recognizer recognizer(imageSize, locator);
+        if (!recognizer.load(modelLoadDir, classifierType)) {
+            std::cerr << "模型或标签映射加载失败: " << modelLoadDir << std::endl;
+            return -1;
+        }
+
+        JobOptions options;
+        options.manifestPath = manifestPath;
+        options.jobDir = jobDir;
+        options.shardIndex = shardIndex;
+        options.shardCount = shardCount;
+        options.checkpointEvery = checkpointEvery;
+        return runRecognitionJob(options, recognizer) ? 0 : -1;
+    }
+
+    if (isPredict && !modelLoadDir.empty() && imageSize != -1) {
+        PlateLocator locator;
+        locator.setParallelBands(numBands);
+        locator.setColorGate(PlateLocator::parsePlateColors(plateColors));
+        Recognizer recognizer(imageSize, locator);
+        if (!recognizer.load(modelLoadDir, classifierType)) {
+            std::cerr << "模型或标签映射加载失败: " << modelLoadDir << std::endl;
             return -1;
         }
 
         if (!imagePath.empty()) {
-            recognizeImage(imagePath, imageSize, classifier);
+            recognizeImage(imagePath, recognizer);
+            return 0;
+        } else if (!videoPath.empty() && isOffline) {
+            recognizeVideoOffline(videoPath, recognizer, outputJsonl, outputVideo, numWorkers);
             return 0;
         } else if (!videoPath.empty()) {
-            recognizeVideo(videoPath, imageSize, classifier);
+            recognizeVideo(videoPath, recognizer, latencyBudgetMs);
             return 0;
         } else if (cameraId >= 0) {
-            recognizeCamera(cameraId, imageSize, classifier);
+            recognizeCamera(cameraId, recognizer, latencyBudgetMs);
             return 0;
         }
     }
 
     std::cerr << "用法:\n"
               << "  数据处理: --raw --input-dir <原始路径> --output-dir <输出路径> [--image-size <尺寸>]\n"
-              << "  模型训练: --train --data-dir <处理后图像路径>\n"
+              << "  模型训练: --train --data-dir <处理后图像路径> [--classifier pca_svm|bit_template] [--prune]\n"
+              << "  分类器对比: --compare --data-dir <处理后图像路径>\n"
+              << "  条带校验: --verify-bands --input-dir <图像目录> [--bands <条带数>] 比较条带并行与整图预处理结果\n"
+              << "  增量更新: --update --model-dir <模型目录> --data-dir <新样本路径> [--eval-dir <评估集路径>]\n"
+              << "            [--full-data-dir <原训练集路径>] 同时执行完整重训以对比准确率与耗时\n"
               << "  图像识别: --predict --model-dir <模型目录> --image-path <图像路径> --image-size <尺寸>\n"
-              << "  视频识别: --predict --model-dir <模型目录> --video-path <视频路径> --image-size <尺寸>\n"
-              << "  摄像头识别: --predict --model-dir <模型目录> --camera-id <ID> --image-size <尺寸>\n"
+              << "  视频识别: --predict --model-dir <模型目录> --video-path <视频路径> --image-size <尺寸> [--latency-budget <毫秒>]\n"
+              << "  离线视频识别: --predict --offline --model-dir <模型目录> --video-path <视频路径> --image-size <尺寸>\n"
+              << "               [--output-jsonl <结果文件>] [--output-video <标注视频>] [--workers <线程数>]\n"
+              << "  批量任务: --job --model-dir <模型目录> --image-size <尺寸> --manifest <清单文件> --job-dir <任务目录>\n"
+              << "            [--shard-index <i> --shard-count <n>] [--checkpoint-every <张数>]\n"
+              << "  合并分片: --merge --job-dir <任务目录> --output-jsonl <结果文件>\n"
+              << "  摄像头识别: --predict --model-dir <模型目录> --camera-id <ID> --image-size <尺寸> [--latency-budget <毫秒>]\n"
+              << "  识别通用选项: [--bands <条带数>] 车牌定位预处理按水平条带并行（与 --plate-colors 同时指定时忽略）\n"
+              << "               [--classifier pca_svm|bit_template] 模型目录中存在多种模型时指定使用的分类器\n"
+              << "               [--plate-colors blue,yellow,green,white] 只在指定车牌底色区域内定位\n"
               << std::endl;
     return -1;
 }
@@ -1,10 +1,12 @@
 #include "model.hpp"
+#include "template_model.hpp"
 #include <filesystem>
 #include <fstream>
+#include <iostream>
 
 PcaSvmClassifier::PcaSvmClassifier(int numComponents_, double svmC_, double svmGamma_, int epochs_)
     : numComponents(numComponents_), svmC(svmC_), svmGamma(svmGamma_), epochs(epochs_),
-      minVal(0.0), maxVal(255.0) {}
+      minVal(0.0), maxVal(255.0), numSamples(0) {}
 
 void PcaSvmClassifier::setNormalizationRange(double minV, double maxV) {
     minVal = minV;
@@ -19,19 +21,93 @@ bool PcaSvmClassifier::train(const cv::Mat& samples, const cv::Mat& labels) {
     samples.convertTo(samplesNorm, CV_32F, 1.0 / (maxVal - minVal), -minVal / (maxVal - minVal));
 
     pca = cv::PCA(samplesNorm, cv::Mat(), cv::PCA::DATA_AS_ROW, numComponents);
+    numSamples = samplesNorm.rows;
     cv::Mat samplesPCA;
     pca.project(samplesNorm, samplesPCA);
 
-    svm = cv::ml::SVM::create();
-    svm->setType(cv::ml::SVM::C_SVC);
-    svm->setKernel(cv::ml::SVM::RBF);
-    svm->setGamma(svmGamma);
-    svm->setC(svmC);
-    svm->setTermCriteria(cv::TermCriteria(cv::TermCriteria::MAX_ITER, epochs, 1e-6));
-
+    svm = createSvm();
     return svm->train(samplesPCA, cv::ml::ROW_SAMPLE, labels);
 }
 
+cv::Ptr<cv::ml::SVM> PcaSvmClassifier::createSvm() const {
+    cv::Ptr<cv::ml::SVM> model = cv::ml::SVM::create();
+    model->setType(cv::ml::SVM::C_SVC);
+    model->setKernel(cv::ml::SVM::RBF);
+    model->setGamma(svmGamma);
+    model->setC(svmC);
+    model->setTermCriteria(cv::TermCriteria(cv::TermCriteria::MAX_ITER, epochs, 1e-6));
+    return model;
+}
+
+// cv::PCA 的特征值来自按样本数归一化的协方差矩阵，由均值、特征向量和特征值可近似还原旧协方差：
+// C = (n1*C1 + n2*C2) / n + n1*n2/n^2 * (m1-m2)^T (m1-m2)
+bool PcaSvmClassifier::updatePca(const cv::Mat& samplesNorm) {
+    if (numSamples <= 0 || pca.eigenvalues.empty()) return false;
+
+    cv::Mat oldMean, oldVecs, oldVals;
+    pca.mean.convertTo(oldMean, CV_64F);
+    pca.eigenvectors.convertTo(oldVecs, CV_64F);
+    pca.eigenvalues.reshape(1, 1).convertTo(oldVals, CV_64F);
+
+    cv::Mat oldCovar = oldVecs.t() * cv::Mat::diag(oldVals) * oldVecs;
+
+    cv::Mat newCovar, newMean;
+    cv::calcCovarMatrix(samplesNorm, newCovar, newMean,
+                        cv::COVAR_NORMAL | cv::COVAR_ROWS | cv::COVAR_SCALE, CV_64F);
+    newMean.convertTo(newMean, CV_64F);
+
+    double n1 = numSamples, n2 = samplesNorm.rows, n = n1 + n2;
+    cv::Mat meanDiff = oldMean - newMean;
+    cv::Mat covar = (n1 * oldCovar + n2 * newCovar) / n + (n1 * n2 / (n * n)) * (meanDiff.t() * meanDiff);
+    cv::Mat mean = (n1 * oldMean + n2 * newMean) / n;
+
+    cv::Mat eigenvalues, eigenvectors;
+    if (!cv::eigen(covar, eigenvalues, eigenvectors)) return false;
+
+    int k = std::min(numComponents, eigenvectors.rows);
+    mean.convertTo(pca.mean, CV_32F);
+    eigenvectors.rowRange(0, k).convertTo(pca.eigenvectors, CV_32F);
+    eigenvalues.rowRange(0, k).convertTo(pca.eigenvalues, CV_32F);
+    numSamples += samplesNorm.rows;
+    return true;
+}
+
+bool PcaSvmClassifier::update(const cv::Mat& samples, const cv::Mat& labels) {
+    if (svm.empty() || pca.eigenvectors.empty()) return train(samples, labels);
+    if (samples.empty() || samples.rows != labels.rows || samples.cols != pca.eigenvectors.cols) return false;
+
+    // 归一化范围沿用旧模型，保证新旧样本处于同一尺度
+    cv::Mat samplesNorm;
+    samples.convertTo(samplesNorm, CV_32F, 1.0 / (maxVal - minVal), -minVal / (maxVal - minVal));
+
+    // 旧支持向量刻画了原决策边界，先用旧模型标注并回投到像素空间，作为旧数据的代表
+    cv::Mat oldSupport = svm->getSupportVectors();
+    cv::Mat oldSupportLabels, oldSupportPixels;
+    if (!oldSupport.empty()) {
+        svm->predict(oldSupport, oldSupportLabels);
+        oldSupportLabels.convertTo(oldSupportLabels, CV_32S);
+        pca.backProject(oldSupport, oldSupportPixels);
+    }
+
+    if (!updatePca(samplesNorm)) {
+        std::cerr << "旧模型缺少样本数或特征值，保持 PCA 基不变，仅更新 SVM" << std::endl;
+    }
+
+    cv::Mat trainPixels = samplesNorm.clone(), trainLabels = labels.clone();
+    if (!oldSupportPixels.empty()) {
+        trainPixels.push_back(oldSupportPixels);
+        trainLabels.push_back(oldSupportLabels);
+    }
+
+    cv::Mat trainPCA;
+    pca.project(trainPixels, trainPCA);
+
+    cv::Ptr<cv::ml::SVM> updated = createSvm();
+    if (!updated->train(trainPCA, cv::ml::ROW_SAMPLE, trainLabels)) return false;
+    svm = updated;
+    return true;
+}
+
 int PcaSvmClassifier::predict(const cv::Mat& processedCharImage) const {
     if (svm.empty() || pca.eigenvectors.empty()) return -1;
 
@@ -52,6 +128,8 @@ bool PcaSvmClassifier::save(const std::string& dirPath) const {
     cv::FileStorage fs(dirPath + "/pca.yml", cv::FileStorage::WRITE);
     fs << "mean" << pca.mean;
     fs << "eigenvectors" << pca.eigenvectors;
+    fs << "eigenvalues" << pca.eigenvalues;
+    fs << "numSamples" << numSamples;
     fs << "minVal" << minVal;
     fs << "maxVal" << maxVal;
     fs << "numComponents" << numComponents;
@@ -69,6 +147,11 @@ bool PcaSvmClassifier::load(const std::string& dirPath) {
 
     fs["mean"] >> pca.mean;
     fs["eigenvectors"] >> pca.eigenvectors;
+    // 早期模型未保存特征值与样本数，此时增量更新无法合并协方差
+    pca.eigenvalues.release();
+    numSamples = 0;
+    if (!fs["eigenvalues"].empty()) fs["eigenvalues"] >> pca.eigenvalues;
+    if (!fs["numSamples"].empty()) fs["numSamples"] >> numSamples;
     fs["minVal"] >> minVal;
     fs["maxVal"] >> maxVal;
     fs["numComponents"] >> numComponents;
@@ -80,7 +163,7 @@ bool PcaSvmClassifier::load(const std::string& dirPath) {
     return !svm.empty();
 }
 
-void PcaSvmClassifier::buildLabelMapFromDir(const std::string& dataDir) {
+void CharClassifier::buildLabelMapFromDir(const std::string& dataDir) {
     labelMap.clear();
     inverseMap.clear();
     int labelId = 0;
@@ -93,7 +176,7 @@ void PcaSvmClassifier::buildLabelMapFromDir(const std::string& dataDir) {
     }
 }
 
-bool PcaSvmClassifier::saveLabelMap(const std::string& dirPath) const {
+bool CharClassifier::saveLabelMap(const std::string& dirPath) const {
     std::ofstream ofs(dirPath  + "/label_map.txt");
     if (!ofs.is_open()) return false;
     for (const auto& [k, v] : labelMap) {
@@ -102,7 +185,7 @@ bool PcaSvmClassifier::saveLabelMap(const std::string& dirPath) const {
     return true;
 }
 
-bool PcaSvmClassifier::loadLabelMap(const std::string& dirPath) {
+bool CharClassifier::loadLabelMap(const std::string& dirPath) {
     labelMap.clear();
     inverseMap.clear();
     std::ifstream ifs(dirPath);
@@ -116,12 +199,31 @@ bool PcaSvmClassifier::loadLabelMap(const std::string& dirPath) {
     return true;
 }
 
-int PcaSvmClassifier::labelToId(const std::string& label) const {
+int CharClassifier::labelToId(const std::string& label) const {
     auto it = labelMap.find(label);
     return it == labelMap.end() ? -1 : it->second;
 }
 
-std::string PcaSvmClassifier::idToLabel(int id) const {
+std::string CharClassifier::idToLabel(int id) const {
     auto it = inverseMap.find(id);
     return it == inverseMap.end() ? "" : it->second;
-}
\ No newline at end of file
+}
+
+std::unique_ptr<CharClassifier> createClassifier(const std::string& type) {
+    if (type == "pca_svm") return std::make_unique<PcaSvmClassifier>();
+    if (type == "bit_template") return std::make_unique<BitTemplateClassifier>();
+    return nullptr;
+}
+
+std::unique_ptr<CharClassifier> loadClassifier(const std::string& dirPath, const std::string& type) {
+    std::string resolved = type;
+    if (resolved.empty()) {
+        if (std::filesystem::exists(dirPath + "/pca.yml")) resolved = "pca_svm";
+        else if (std::filesystem::exists(dirPath + "/templates.yml")) resolved = "bit_template";
+        else return nullptr;
+    }
+
+    std::unique_ptr<CharClassifier> classifier = createClassifier(resolved);
+    if (!classifier || !classifier->load(dirPath)) return nullptr;
+    return classifier;
+}
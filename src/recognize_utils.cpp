@@ -2,36 +2,27 @@
 
 #include <opencv2/opencv.hpp>
 #include <iostream>
-#include "PlateLocator.hpp"
-#include "image_utils.hpp"
-
-cv::Mat processFrame(const cv::Mat& src, int imgSize, PcaSvmClassifier& classifier) {
-    PlateLocator locator;
-    cv::Mat resized, preprocessed;
-    locator.preprocess(src, resized, preprocessed);
-    cv::Mat drawImg = resized.clone();
-    std::vector<cv::Rect> plates = locator.locatePlates(preprocessed);
-    if (plates.empty()) {
-        std::cout << "处理失败或未检测到车牌" << std::endl;
-        return drawImg;
-    }
-
-    cv::Mat plateImg = resized(plates[0]);
-    std::vector<cv::Mat> chars = locator.segmentCharacters(plateImg);
-    std::cout << "分割出字符数量：" << chars.size() << std::endl;
-
-    std::string plateText;
-    for (size_t i = 0; i < chars.size(); ++i) {
-        cv::Mat processedImg = charImgProcess(chars[i], imgSize);
+#include <iomanip>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+#include <climits>
+#include <memory>
+#include "LatencyController.hpp"
 
-        int pred = classifier.predict(processedImg);
-        std::string label = classifier.idToLabel(pred);
-        plateText += label;
-    }
-
-    std::cout << "车牌号: " + plateText << std::endl;
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+extern char** environ;
+#endif
 
-    cv::Rect plateRect = plates[0];
+static void drawPlate(cv::Mat& drawImg, const cv::Rect& plateRect, const std::string& plateText) {
     cv::rectangle(drawImg, plateRect, cv::Scalar(0, 255, 0), 2);
 
     // 在车牌框上方标注识别出的车牌号
@@ -47,17 +38,43 @@ cv::Mat processFrame(const cv::Mat& src, int imgSize, PcaSvmClassifier& classifi
         textOrg.y = plateRect.y + textSize.height + 5;
     }
     cv::putText(drawImg, plateText, textOrg, font, fontScale, cv::Scalar(0, 0, 255), thickness);
+}
 
+static cv::Mat drawResults(const cv::Mat& src, const std::vector<PlateResult>& results) {
+    cv::Mat drawImg = src.clone();
+    for (const auto& r : results) drawPlate(drawImg, r.rect, r.text);
     return drawImg;
 }
 
-void recognizeImage(const std::string& imagePath, int imgSize, PcaSvmClassifier& classifier) {
+cv::Mat processFrame(const cv::Mat& src, const Recognizer& recognizer, LatencyController* controller = nullptr) {
+    std::vector<PlateResult> results;
+    if (controller) {
+        const LocatorProfile& profile = controller->current();
+        StageTimes times;
+        results = recognizer.recognize(src, profile.locator, recognizer.getMaxPlates(), &times);
+        controller->update(times);
+    } else {
+        results = recognizer.recognize(src);
+    }
+    if (results.empty()) {
+        std::cout << "处理失败或未检测到车牌" << std::endl;
+        return src.clone();
+    }
+
+    for (const auto& r : results) {
+        std::cout << "分割出字符数量：" << r.charIds.size() << std::endl;
+        std::cout << "车牌号: " + r.text << std::endl;
+    }
+    return drawResults(src, results);
+}
+
+void recognizeImage(const std::string& imagePath, const Recognizer& recognizer) {
     cv::Mat img = cv::imread(imagePath);
     if (img.empty()) {
         std::cerr << "图像加载失败: " << imagePath << std::endl;
         return;
     }
-    cv::Mat drawFrame = processFrame(img, imgSize, classifier);
+    cv::Mat drawFrame = processFrame(img, recognizer);
     if (drawFrame.empty()) {
         std::cout << "处理失败或未检测到车牌" << std::endl;
     } else {
@@ -66,32 +83,321 @@ void recognizeImage(const std::string& imagePath, int imgSize, PcaSvmClassifier&
     }
 }
 
-void recognizeVideo(const std::string& videoPath, int imgSize, PcaSvmClassifier& classifier) {
+void recognizeVideo(const std::string& videoPath, const Recognizer& recognizer, double latencyBudgetMs) {
     cv::VideoCapture cap(videoPath);
     if (!cap.isOpened()) {
         std::cerr << "无法打开视频: " << videoPath << std::endl;
         return;
     }
 
+    std::unique_ptr<LatencyController> controller;
+    if (latencyBudgetMs > 0) {
+        controller = std::make_unique<LatencyController>(
+            latencyBudgetMs, LatencyController::defaultProfiles(recognizer.getLocator().getParallelBands(),
+                                                                recognizer.getLocator().getColorGate()));
+    }
+
     cv::Mat frame;
     while (cap.read(frame)) {
-        cv::Mat drawImg = processFrame(frame, imgSize, classifier);
+        cv::Mat drawImg = processFrame(frame, recognizer, controller.get());
         cv::imshow("Video Frame", drawImg);
         if (cv::waitKey(30) == 27) break;
     }
 }
 
-void recognizeCamera(int cameraId, int imgSize, PcaSvmClassifier& classifier) {
+void recognizeCamera(int cameraId, const Recognizer& recognizer, double latencyBudgetMs) {
     cv::VideoCapture cap(cameraId);
     if (!cap.isOpened()) {
         std::cerr << "无法打开摄像头: " << cameraId << std::endl;
         return;
     }
 
+    std::unique_ptr<LatencyController> controller;
+    if (latencyBudgetMs > 0) {
+        controller = std::make_unique<LatencyController>(
+            latencyBudgetMs, LatencyController::defaultProfiles(recognizer.getLocator().getParallelBands(),
+                                                                recognizer.getLocator().getColorGate()));
+    }
+
     cv::Mat frame;
     while (cap.read(frame)) {
-        cv::Mat drawImg = processFrame(frame, imgSize, classifier);
+        cv::Mat drawImg = processFrame(frame, recognizer, controller.get());
         cv::imshow("Camera", drawImg);
         if (cv::waitKey(30) == 27) break;
     }
 }
+
+struct OfflineFrameResult {
+    int frameIndex;
+    double timestampMs;
+    cv::Rect plateRect;     // 原始帧坐标
+    std::string plateText;
+};
+
+struct OfflineSegment {
+    int startFrame, endFrame;           // [startFrame, endFrame)
+    std::string partVideoPath;
+    std::vector<OfflineFrameResult> results;
+    int framesRead = 0;
+    int framesWithPlates = 0;
+};
+
+std::string jsonEscape(const std::string& s) {
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buf[8];
+                    std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    return out;
+}
+
+// 每个工作线程独立打开 VideoCapture 并跳转到分段起点。含 B 帧、可变帧率或起始时间非零的流上
+// 按帧号跳转并不精确，因此跳转后回读实际位置：落在起点之前则向前解码补齐，越过起点则告警，
+// 帧号以实际位置为准，时间戳取自解码器给出的 CAP_PROP_POS_MSEC。
+static void processSegment(const std::string& videoPath, const Recognizer& recognizer,
+                           double fps, int fourcc, OfflineSegment& segment) {
+    cv::VideoCapture cap(videoPath);
+    if (!cap.isOpened()) {
+        std::cerr << "无法打开视频: " << videoPath << std::endl;
+        return;
+    }
+
+    int idx = 0;
+    if (segment.startFrame > 0) {
+        cap.set(cv::CAP_PROP_POS_FRAMES, segment.startFrame);
+        idx = static_cast<int>(cap.get(cv::CAP_PROP_POS_FRAMES));
+        while (idx < segment.startFrame && cap.grab()) ++idx;
+        if (idx != segment.startFrame) {
+            std::cerr << "分段跳转不精确: 期望第 " << segment.startFrame << " 帧，实际第 " << idx
+                      << " 帧，分段边界处可能缺帧" << std::endl;
+        }
+    }
+
+    cv::VideoWriter writer;
+    cv::Mat frame;
+    for (; idx < segment.endFrame && cap.read(frame); ++idx) {
+        double timestampMs = cap.get(cv::CAP_PROP_POS_MSEC);
+        if (timestampMs < 0) timestampMs = idx * 1000.0 / fps;
+
+        ++segment.framesRead;
+        std::vector<PlateResult> plates = recognizer.recognize(frame);
+        if (!plates.empty()) ++segment.framesWithPlates;
+        for (const auto& p : plates) {
+            segment.results.push_back({ idx, timestampMs, p.rect, p.text });
+        }
+
+        if (!segment.partVideoPath.empty()) {
+            cv::Mat drawImg = drawResults(frame, plates);
+            if (!writer.isOpened()) {
+                writer.open(segment.partVideoPath, fourcc, fps, drawImg.size());
+                if (!writer.isOpened()) {
+                    std::cerr << "无法创建分段视频: " << segment.partVideoPath << std::endl;
+                    segment.partVideoPath.clear();
+                    continue;
+                }
+            }
+            writer.write(drawImg);
+        }
+    }
+}
+
+static int fourccForPath(const std::string& path) {
+    std::string ext = std::filesystem::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    if (ext == ".mp4" || ext == ".m4v" || ext == ".mov") return cv::VideoWriter::fourcc('m', 'p', '4', 'v');
+    return cv::VideoWriter::fourcc('M', 'J', 'P', 'G');
+}
+
+// 不经过 shell 直接启动外部程序并等待其结束，参数中的路径不会被解释为命令
+static bool runProgram(const std::vector<std::string>& args) {
+#ifdef _WIN32
+    // _spawnvp 按空格拼接参数，需按 MSVC 命令行规则给每个参数加引号
+    std::vector<std::string> quoted;
+    for (const auto& arg : args) {
+        std::string q = "\"";
+        size_t backslashes = 0;
+        for (char c : arg) {
+            if (c == '\\') {
+                ++backslashes;
+                continue;
+            }
+            q.append(c == '"' ? backslashes * 2 + 1 : backslashes, '\\');
+            backslashes = 0;
+            q += c;
+        }
+        q.append(backslashes * 2, '\\');
+        quoted.push_back(q + "\"");
+    }
+    std::vector<const char*> argv;
+    for (const auto& q : quoted) argv.push_back(q.c_str());
+    argv.push_back(nullptr);
+    return _spawnvp(_P_WAIT, args[0].c_str(), argv.data()) == 0;
+#else
+    std::vector<char*> argv;
+    for (const auto& arg : args) argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+    pid_t pid;
+    if (posix_spawnp(&pid, args[0].c_str(), nullptr, nullptr, argv.data(), environ) != 0) return false;
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0) return false;
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
+
+// 快速路径：各分段已按最终编码与容器写出，用 ffmpeg concat 分离器流拷贝拼接，不重新编码
+static bool concatWithFfmpeg(const std::vector<std::string>& parts, const std::string& outVideoPath) {
+    std::string listPath = outVideoPath + ".parts.txt";
+    {
+        std::ofstream list(listPath);
+        if (!list.is_open()) return false;
+        for (const auto& part : parts) {
+            std::string absPath = std::filesystem::absolute(part).string();
+            std::replace(absPath.begin(), absPath.end(), '\\', '/');
+            std::string escaped;
+            for (char c : absPath) {
+                if (c == '\'') escaped += "'\\''";
+                else escaped += c;
+            }
+            list << "file '" << escaped << "'\n";
+        }
+    }
+
+    bool ok = runProgram({ "ffmpeg", "-v", "error", "-y", "-f", "concat", "-safe", "0",
+                           "-i", listPath, "-c", "copy", outVideoPath });
+    std::error_code ec;
+    std::filesystem::remove(listPath, ec);
+    return ok;
+}
+
+// 回退路径：没有 ffmpeg 或拼接失败时在进程内按顺序解码各分段并用 VideoWriter 写出
+static bool concatWithVideoWriter(const std::vector<std::string>& parts, const std::string& outVideoPath,
+                                  int fourcc, double fps) {
+    cv::VideoWriter writer;
+    cv::Mat frame;
+    for (const auto& part : parts) {
+        cv::VideoCapture cap(part);
+        if (!cap.isOpened()) {
+            std::cerr << "无法打开分段视频: " << part << std::endl;
+            return false;
+        }
+        while (cap.read(frame)) {
+            if (!writer.isOpened()) {
+                writer.open(outVideoPath, fourcc, fps, frame.size());
+                if (!writer.isOpened()) {
+                    std::cerr << "无法创建输出视频: " << outVideoPath << std::endl;
+                    return false;
+                }
+            }
+            writer.write(frame);
+        }
+    }
+    return writer.isOpened();
+}
+
+// 按分段顺序拼接标注视频，优先流拷贝，失败时在进程内重新编码；成功后删除分段文件，失败时保留
+static bool concatSegments(const std::vector<OfflineSegment>& segments, const std::string& outVideoPath,
+                           int fourcc, double fps) {
+    std::vector<std::string> parts;
+    for (const auto& segment : segments) {
+        if (!segment.partVideoPath.empty() && std::filesystem::exists(segment.partVideoPath)) {
+            parts.push_back(segment.partVideoPath);
+        }
+    }
+    if (parts.empty()) return false;
+
+    bool ok = concatWithFfmpeg(parts, outVideoPath);
+    if (!ok) {
+        std::cerr << "ffmpeg 流拷贝拼接不可用，改为在进程内重新编码拼接" << std::endl;
+        ok = concatWithVideoWriter(parts, outVideoPath, fourcc, fps);
+    }
+    if (!ok) {
+        std::cerr << "分段视频拼接失败，分段文件已保留" << std::endl;
+        return false;
+    }
+
+    std::error_code ec;
+    for (const auto& part : parts) std::filesystem::remove(part, ec);
+    return true;
+}
+
+void recognizeVideoOffline(const std::string& videoPath, const Recognizer& recognizer,
+                           const std::string& jsonlPath, const std::string& outVideoPath, int numWorkers) {
+    cv::VideoCapture probe(videoPath);
+    if (!probe.isOpened()) {
+        std::cerr << "无法打开视频: " << videoPath << std::endl;
+        return;
+    }
+    int frameCount = static_cast<int>(probe.get(cv::CAP_PROP_FRAME_COUNT));
+    double fps = probe.get(cv::CAP_PROP_FPS);
+    probe.release();
+    if (fps <= 0) fps = 25.0;
+
+    if (numWorkers <= 0) numWorkers = std::max(1u, std::thread::hardware_concurrency());
+    // 容器未给出总帧数时无法分段，退化为单线程顺序处理
+    if (frameCount <= 0) numWorkers = 1;
+    else numWorkers = std::min(numWorkers, frameCount);
+
+    std::vector<OfflineSegment> segments(numWorkers);
+    for (int i = 0; i < numWorkers; ++i) {
+        segments[i].startFrame = frameCount <= 0 ? 0 : static_cast<int>(static_cast<long long>(frameCount) * i / numWorkers);
+        segments[i].endFrame = static_cast<int>(static_cast<long long>(frameCount) * (i + 1) / numWorkers);
+        if (!outVideoPath.empty()) {
+            std::filesystem::path out(outVideoPath);
+            segments[i].partVideoPath = outVideoPath + ".part" + std::to_string(i) + out.extension().string();
+        }
+    }
+    // 容器记录的总帧数可能偏小，最后一段一直读到文件末尾
+    segments.back().endFrame = INT_MAX;
+
+    std::cout << "离线识别: " << videoPath << "，总帧数 " << frameCount << "，分段数 " << numWorkers << std::endl;
+    auto t0 = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for (auto& segment : segments) {
+        workers.emplace_back(processSegment, std::cref(videoPath), std::cref(recognizer), fps,
+                             fourccForPath(outVideoPath), std::ref(segment));
+    }
+    for (auto& w : workers) w.join();
+
+    size_t totalFrames = 0, totalPlateFrames = 0, totalPlates = 0;
+    std::ofstream jsonl;
+    if (!jsonlPath.empty()) {
+        jsonl.open(jsonlPath);
+        if (!jsonl.is_open()) std::cerr << "无法写入结果文件: " << jsonlPath << std::endl;
+    }
+    for (const auto& segment : segments) {
+        totalFrames += segment.framesRead;
+        totalPlateFrames += segment.framesWithPlates;
+        totalPlates += segment.results.size();
+        if (!jsonl.is_open()) continue;
+        for (const auto& r : segment.results) {
+            jsonl << "{\"frame\":" << r.frameIndex
+                  << ",\"time_ms\":" << std::fixed << std::setprecision(1) << r.timestampMs
+                  << ",\"plate\":\"" << jsonEscape(r.plateText) << "\""
+                  << ",\"rect\":[" << r.plateRect.x << "," << r.plateRect.y << ","
+                  << r.plateRect.width << "," << r.plateRect.height << "]}\n";
+        }
+    }
+
+    if (!outVideoPath.empty()) concatSegments(segments, outVideoPath, fourccForPath(outVideoPath), fps);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "处理帧数: " << totalFrames << "，识别到车牌的帧数: " << totalPlateFrames
+              << "，车牌数: " << totalPlates
+              << "，耗时 " << std::fixed << std::setprecision(2) << seconds << " s ("
+              << (seconds > 0 ? totalFrames / seconds : 0.0) << " fps)" << std::endl;
+}
@@ -0,0 +1,242 @@
+#include "template_model.hpp"
+#include <algorithm>
+#include <bitset>
+#include <climits>
+#include <cstring>
+#include <filesystem>
+#include <numeric>
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+static inline int popcount64(uint64_t v) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    return static_cast<int>(__popcnt64(v));
+#elif defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(v);
+#else
+    return static_cast<int>(std::bitset<64>(v).count());
+#endif
+}
+
+BitTemplateClassifier::BitTemplateClassifier(int k_)
+    : k(std::max(1, k_)), numBits(0), numWords(0) {}
+
+void BitTemplateClassifier::packRow(const cv::Mat& row, uint64_t* dst) const {
+    std::fill(dst, dst + numWords, 0);
+    cv::Mat bytes = row;
+    if (row.depth() != CV_8U) row.convertTo(bytes, CV_8U);
+    if (!bytes.isContinuous()) bytes = bytes.clone();
+    const uchar* p = bytes.ptr<uchar>(0);
+    for (int i = 0; i < numBits; ++i) {
+        if (p[i] > 127) dst[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+}
+
+int BitTemplateClassifier::hamming(const uint64_t* a, const uint64_t* b) const {
+    int d = 0;
+    for (int w = 0; w < numWords; ++w) d += popcount64(a[w] ^ b[w]);
+    return d;
+}
+
+bool BitTemplateClassifier::train(const cv::Mat& samples, const cv::Mat& labels_) {
+    if (samples.empty() || samples.rows != labels_.rows) return false;
+
+    numBits = samples.cols * samples.channels();
+    numWords = (numBits + 63) / 64;
+    codes.assign(static_cast<size_t>(samples.rows) * numWords, 0);
+    labels.resize(samples.rows);
+
+    cv::Mat labelsInt;
+    labels_.convertTo(labelsInt, CV_32S);
+    for (int i = 0; i < samples.rows; ++i) {
+        packRow(samples.row(i), &codes[static_cast<size_t>(i) * numWords]);
+        labels[i] = labelsInt.at<int>(i, 0);
+    }
+    return true;
+}
+
+bool BitTemplateClassifier::update(const cv::Mat& samples, const cv::Mat& labels_) {
+    if (labels.empty()) return train(samples, labels_);
+    if (samples.empty() || samples.rows != labels_.rows || samples.cols * samples.channels() != numBits) return false;
+
+    size_t oldSize = labels.size();
+    codes.resize((oldSize + samples.rows) * numWords, 0);
+    labels.resize(oldSize + samples.rows);
+
+    cv::Mat labelsInt;
+    labels_.convertTo(labelsInt, CV_32S);
+    for (int i = 0; i < samples.rows; ++i) {
+        packRow(samples.row(i), &codes[(oldSize + i) * numWords]);
+        labels[oldSize + i] = labelsInt.at<int>(i, 0);
+    }
+    deduplicate();
+    return true;
+}
+
+int BitTemplateClassifier::predict(const cv::Mat& binaryCharImage) const {
+    if (labels.empty() || static_cast<int>(binaryCharImage.total() * binaryCharImage.channels()) != numBits) return -1;
+
+    uint64_t query[64];
+    std::vector<uint64_t> heapQuery;
+    uint64_t* q = query;
+    if (numWords > 64) {
+        heapQuery.resize(numWords);
+        q = heapQuery.data();
+    }
+    cv::Mat img = binaryCharImage.isContinuous() ? binaryCharImage : binaryCharImage.clone();
+    packRow(img.reshape(1, 1), q);
+
+    // 维护按距离升序的前 k 个近邻
+    int kk = std::min<int>(k, static_cast<int>(labels.size()));
+    std::vector<std::pair<int, int>> best(kk, { INT_MAX, -1 });
+    for (size_t i = 0; i < labels.size(); ++i) {
+        int d = hamming(q, &codes[i * numWords]);
+        if (d >= best.back().first) continue;
+        int j = kk - 1;
+        while (j > 0 && best[j - 1].first > d) {
+            best[j] = best[j - 1];
+            --j;
+        }
+        best[j] = { d, labels[i] };
+    }
+
+    // 多数投票，票数相同时取最近者所在类别
+    int bestLabel = best[0].second, bestVotes = 0;
+    for (int i = 0; i < kk; ++i) {
+        int votes = 0;
+        for (int j = 0; j < kk; ++j) votes += best[j].second == best[i].second;
+        if (votes > bestVotes) {
+            bestVotes = votes;
+            bestLabel = best[i].second;
+        }
+    }
+    return bestLabel;
+}
+
+size_t BitTemplateClassifier::deduplicate() {
+    size_t n = labels.size();
+    std::vector<size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    auto less = [this](size_t a, size_t b) {
+        int c = std::memcmp(&codes[a * numWords], &codes[b * numWords], numWords * sizeof(uint64_t));
+        return c != 0 ? c < 0 : labels[a] < labels[b];
+    };
+    std::sort(order.begin(), order.end(), less);
+
+    std::vector<bool> keep(n, true);
+    for (size_t i = 1; i < n; ++i) {
+        size_t a = order[i - 1], b = order[i];
+        if (labels[a] == labels[b] &&
+            std::memcmp(&codes[a * numWords], &codes[b * numWords], numWords * sizeof(uint64_t)) == 0) {
+            keep[b] = false;
+        }
+    }
+
+    std::vector<uint64_t> newCodes;
+    std::vector<int> newLabels;
+    for (size_t i = 0; i < n; ++i) {
+        if (!keep[i]) continue;
+        newCodes.insert(newCodes.end(), codes.begin() + i * numWords, codes.begin() + (i + 1) * numWords);
+        newLabels.push_back(labels[i]);
+    }
+    codes.swap(newCodes);
+    labels.swap(newLabels);
+    return n - labels.size();
+}
+
+int BitTemplateClassifier::nearestLabel(const uint64_t* query, const std::vector<size_t>& subset) const {
+    int bestDist = INT_MAX, bestLabel = -1;
+    for (size_t idx : subset) {
+        int d = hamming(query, &codes[idx * numWords]);
+        if (d < bestDist) {
+            bestDist = d;
+            bestLabel = labels[idx];
+        }
+    }
+    return bestLabel;
+}
+
+size_t BitTemplateClassifier::condense() {
+    size_t n = labels.size();
+    if (n == 0) return 0;
+
+    // 每个类别先放入第一个样本，再反复吸收被当前原型集误分的样本，直到一轮中没有新增
+    std::vector<size_t> store;
+    std::vector<bool> inStore(n, false);
+    std::map<int, bool> seen;
+    for (size_t i = 0; i < n; ++i) {
+        if (seen[labels[i]]) continue;
+        seen[labels[i]] = true;
+        store.push_back(i);
+        inStore[i] = true;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t i = 0; i < n; ++i) {
+            if (inStore[i]) continue;
+            if (nearestLabel(&codes[i * numWords], store) != labels[i]) {
+                store.push_back(i);
+                inStore[i] = true;
+                changed = true;
+            }
+        }
+    }
+
+    std::sort(store.begin(), store.end());
+    std::vector<uint64_t> newCodes;
+    std::vector<int> newLabels;
+    for (size_t idx : store) {
+        newCodes.insert(newCodes.end(), codes.begin() + idx * numWords, codes.begin() + (idx + 1) * numWords);
+        newLabels.push_back(labels[idx]);
+    }
+    codes.swap(newCodes);
+    labels.swap(newLabels);
+    // 压缩后的原型集只保证 1-NN 与原训练集一致，k 近邻投票会被稀疏的原型带偏，随模型一并保存为 k = 1
+    k = 1;
+    return n - labels.size();
+}
+
+bool BitTemplateClassifier::save(const std::string& dirPath) const {
+    if (labels.empty()) return false;
+    std::filesystem::create_directories(dirPath);
+
+    // 编码按字节保存，标签为 N x 1 的 int 矩阵
+    cv::Mat codeMat(static_cast<int>(labels.size()), numWords * static_cast<int>(sizeof(uint64_t)), CV_8U,
+                    const_cast<uint64_t*>(codes.data()));
+    cv::Mat labelMat(static_cast<int>(labels.size()), 1, CV_32S, const_cast<int*>(labels.data()));
+
+    cv::FileStorage fs(dirPath + "/templates.yml", cv::FileStorage::WRITE_BASE64);
+    if (!fs.isOpened()) return false;
+    fs << "k" << k;
+    fs << "numBits" << numBits;
+    fs << "codes" << codeMat;
+    fs << "labels" << labelMat;
+    fs.release();
+    return true;
+}
+
+bool BitTemplateClassifier::load(const std::string& dirPath) {
+    cv::FileStorage fs(dirPath + "/templates.yml", cv::FileStorage::READ);
+    if (!fs.isOpened()) return false;
+
+    cv::Mat codeMat, labelMat;
+    fs["k"] >> k;
+    fs["numBits"] >> numBits;
+    fs["codes"] >> codeMat;
+    fs["labels"] >> labelMat;
+    fs.release();
+
+    numWords = (numBits + 63) / 64;
+    if (codeMat.rows != labelMat.rows || codeMat.cols != numWords * static_cast<int>(sizeof(uint64_t))) return false;
+
+    codes.resize(static_cast<size_t>(codeMat.rows) * numWords);
+    labels.resize(labelMat.rows);
+    for (int i = 0; i < codeMat.rows; ++i) {
+        std::memcpy(&codes[static_cast<size_t>(i) * numWords], codeMat.ptr<uchar>(i), numWords * sizeof(uint64_t));
+        labels[i] = labelMat.at<int>(i, 0);
+    }
+    return !labels.empty();
+}